@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "mmu.h"
+#include "pagetable.h"
+#include "simulator.h"
+
+// Workload benchmarks for the Mmu and PageTable. Each scenario runs in its own child process so that peak RSS is
+// measured per scenario, and prints one JSON object per line:
+//   {"scenario":...,"ops":...,"seconds":...,"ops_per_sec":...,"p50_ns":...,"p99_ns":...,"peak_rss_kb":...,
+//    "frames_in_use":...}
+
+#define BENCH_MEMORY_SIZE 67108864
+#define BENCH_MAX_THREADS 8
+
+typedef std::chrono::steady_clock Clock;
+
+typedef struct BenchContext {
+    int page_size;
+    int scale;
+    Mmu *mmu;
+    PageTable *page_table;
+    void *memory;
+    std::vector<uint64_t> latencies;   // Nanoseconds per operation
+} BenchContext;
+
+typedef void (*Scenario)(BenchContext *ctx);
+
+static uint32_t bench_random_state = 12345;
+
+static uint32_t nextRandom()
+{
+    bench_random_state ^= bench_random_state << 13;
+    bench_random_state ^= bench_random_state >> 17;
+    bench_random_state ^= bench_random_state << 5;
+    return bench_random_state;
+}
+
+static uint64_t elapsedNs(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+/** Creates and terminates many small processes. One op is one create or one terminate. */
+static void processChurn(BenchContext *ctx)
+{
+    std::vector<uint32_t> pids;
+    for (int round = 0; round < 20 * ctx->scale; round++)
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            Clock::time_point start = Clock::now();
+            pids.push_back(createProcess(2048, 1024, ctx->mmu, ctx->page_table));
+            ctx->latencies.push_back(elapsedNs(start));
+        }
+        for (int i = 0; i < pids.size(); i++)
+        {
+            Clock::time_point start = Clock::now();
+            terminateProcess(pids[i], ctx->mmu, ctx->page_table);
+            ctx->latencies.push_back(elapsedNs(start));
+        }
+        pids.clear();
+    }
+}
+
+/** Allocates and frees small scalars in random order within one process, from the free space or from slabs. One op is
+ *  one allocate or one free.
+ */
+static void smallObjectChurn(BenchContext *ctx, bool slab)
+{
+    static const DataType types[] = {Char, Short, Int, Float, Long, Double};
+    ctx->mmu->setSlabEnabled(slab);
+    uint32_t pid = createProcess(2048, 1024, ctx->mmu, ctx->page_table);
+    std::vector<std::string> live;
+    int next_name = 0;
+
+    for (int i = 0; i < 50000 * ctx->scale; i++)
+    {
+        Clock::time_point start = Clock::now();
+        if (live.size() < 2000 || nextRandom() % 2 == 0)
+        {
+            std::string name = "v" + std::to_string(next_name++);
+            start = Clock::now();
+            allocateVariable(pid, name, types[nextRandom() % 6], 1, ctx->mmu, ctx->page_table);
+            ctx->latencies.push_back(elapsedNs(start));
+            live.push_back(name);
+        }
+        else
+        {
+            int index = nextRandom() % live.size();
+            std::swap(live[index], live.back());
+            start = Clock::now();
+            freeVariable(pid, live.back(), ctx->mmu, ctx->page_table);
+            ctx->latencies.push_back(elapsedNs(start));
+            live.pop_back();
+        }
+    }
+}
+
+static void smallObjectChurnFreeSpace(BenchContext *ctx) { smallObjectChurn(ctx, false); }
+static void smallObjectChurnSlab(BenchContext *ctx) { smallObjectChurn(ctx, true); }
+
+/** Allocates large arrays spanning many pages across several processes. One op is one allocate. */
+static void largeArrayAllocation(BenchContext *ctx)
+{
+    for (int round = 0; round < ctx->scale; round++)
+    {
+        std::vector<uint32_t> pids;
+        for (int p = 0; p < 8; p++)
+        {
+            pids.push_back(createProcess(2048, 1024, ctx->mmu, ctx->page_table));
+        }
+        for (int i = 0; i < 1000; i++)
+        {
+            std::string name = "a" + std::to_string(i);
+            Clock::time_point start = Clock::now();
+            allocateVariable(pids[i % pids.size()], name, Int, 4096 + (nextRandom() % 4096), ctx->mmu, ctx->page_table);
+            ctx->latencies.push_back(elapsedNs(start));
+        }
+        for (int p = 0; p < pids.size(); p++)
+        {
+            terminateProcess(pids[p], ctx->mmu, ctx->page_table);
+        }
+    }
+}
+
+/** Forks a process holding a 1 MB array into batches of 32 children, each of which writes a few of its pages. One op
+ *  is one fork. frames_in_use at the end shows the frames the live children share with the parent.
+ */
+static void forkChurn(BenchContext *ctx)
+{
+    uint32_t parent = createProcess(2048, 1024, ctx->mmu, ctx->page_table);
+    allocateVariable(parent, "array", Int, 262144, ctx->mmu, ctx->page_table);
+    std::vector<uint32_t> children;
+    int value = 1;
+
+    for (int i = 0; i < 2000 * ctx->scale; i++)
+    {
+        if (children.size() == 32)
+        {
+            for (int c = 0; c < children.size(); c++)
+            {
+                terminateProcess(children[c], ctx->mmu, ctx->page_table);
+            }
+            children.clear();
+        }
+        Clock::time_point start = Clock::now();
+        uint32_t child = forkProcess(parent, ctx->mmu, ctx->page_table);
+        ctx->latencies.push_back(elapsedNs(start));
+        children.push_back(child);
+        for (int w = 0; w < 4; w++)
+        {
+            setVariable(child, "array", nextRandom() % 262144, &value, ctx->mmu, ctx->page_table, ctx->memory);
+        }
+    }
+}
+
+/** Sets every element of a large int array. One op is a run of 1000 element sets. */
+static void denseSet(BenchContext *ctx)
+{
+    uint32_t pid = createProcess(2048, 1024, ctx->mmu, ctx->page_table);
+    uint32_t num_elements = 1000000;
+    allocateVariable(pid, "data", Int, num_elements, ctx->mmu, ctx->page_table);
+    Variable *variable = ctx->mmu->getVariableByProcessAndName(ctx->mmu->getProcessByPID(pid), "data");
+
+    for (int round = 0; round < 5 * ctx->scale; round++)
+    {
+        for (uint32_t base = 0; base < num_elements; base += 1000)
+        {
+            Clock::time_point start = Clock::now();
+            for (uint32_t i = base; i < base + 1000; i++)
+            {
+                int value = (int)i;
+                setVariableElement(pid, variable, i, &value, ctx->page_table, ctx->memory);
+            }
+            ctx->latencies.push_back(elapsedNs(start));
+        }
+    }
+}
+
+/** Translates random addresses inside mapped variables of many processes. One op is 1000 translations. */
+static void translationReads(BenchContext *ctx)
+{
+    std::vector<uint32_t> pids;
+    for (int p = 0; p < 64; p++)
+    {
+        uint32_t pid = createProcess(2048, 1024, ctx->mmu, ctx->page_table);
+        allocateVariable(pid, "heap", Char, 200000, ctx->mmu, ctx->page_table);
+        pids.push_back(pid);
+    }
+
+    volatile int sink = 0;
+    for (int round = 0; round < 2000 * ctx->scale; round++)
+    {
+        uint32_t pid = pids[nextRandom() % pids.size()];
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < 1000; i++)
+        {
+            sink += ctx->page_table->getPhysicalAddress(pid, nextRandom() % 265000);
+        }
+        ctx->latencies.push_back(elapsedNs(start));
+    }
+}
+
+/** Allocates and frees arrays of mixed sizes in random order across a few processes, with the given heap and
+ *  placement policy. One op is one allocate or one free. frames_in_use at the end shows how tightly the heap packs pages.
+ */
+static void mixedChurn(BenchContext *ctx, HeapBackend heap, PlacementPolicy policy)
+{
+    static const DataType types[] = {Char, Short, Int, Double};
+    ctx->mmu->setHeapBackend(heap);
+    ctx->mmu->setPlacementPolicy(policy);
+    std::vector<uint32_t> pids;
+    for (int p = 0; p < 4; p++)
+    {
+        pids.push_back(createProcess(2048, 1024, ctx->mmu, ctx->page_table));
+    }
+    std::vector<std::pair<uint32_t, std::string> > live;
+    int next_name = 0;
+
+    for (int i = 0; i < 40000 * ctx->scale; i++)
+    {
+        Clock::time_point start;
+        if (live.size() < 1000 || nextRandom() % 2 == 0)
+        {
+            uint32_t pid = pids[nextRandom() % pids.size()];
+            std::string name = "m" + std::to_string(next_name++);
+            uint32_t num_elements = (nextRandom() % 8 == 0) ? 512 + nextRandom() % 4096 : 1 + nextRandom() % 64;
+            DataType type = types[nextRandom() % 4];
+            start = Clock::now();
+            allocateVariable(pid, name, type, num_elements, ctx->mmu, ctx->page_table);
+            ctx->latencies.push_back(elapsedNs(start));
+            live.push_back(std::make_pair(pid, name));
+        }
+        else
+        {
+            int index = nextRandom() % live.size();
+            std::swap(live[index], live.back());
+            start = Clock::now();
+            freeVariable(live.back().first, live.back().second, ctx->mmu, ctx->page_table);
+            ctx->latencies.push_back(elapsedNs(start));
+            live.pop_back();
+        }
+    }
+}
+
+static void mixedChurnFirstFit(BenchContext *ctx) { mixedChurn(ctx, FreeListHeap, FirstFit); }
+static void mixedChurnNextFit(BenchContext *ctx) { mixedChurn(ctx, FreeListHeap, NextFit); }
+static void mixedChurnBestFit(BenchContext *ctx) { mixedChurn(ctx, FreeListHeap, BestFit); }
+static void mixedChurnWorstFit(BenchContext *ctx) { mixedChurn(ctx, FreeListHeap, WorstFit); }
+static void mixedChurnBuddy(BenchContext *ctx) { mixedChurn(ctx, BuddyHeap, BestFit); }
+
+/** One simulated CPU of parallelChurn: allocates, sets and frees variables in its own process, and creates and
+ *  terminates a short lived process every so often.
+ */
+static void parallelChurnWorker(BenchContext *ctx, uint32_t seed, std::vector<uint64_t> *latencies)
+{
+    uint32_t random_state = seed;
+    uint32_t pid = createProcess(2048, 1024, ctx->mmu, ctx->page_table);
+    std::vector<std::string> live;
+    int next_name = 0;
+
+    for (int i = 0; i < 20000 * ctx->scale; i++)
+    {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+
+        Clock::time_point start = Clock::now();
+        if (i % 1000 == 999)
+        {
+            terminateProcess(createProcess(2048, 1024, ctx->mmu, ctx->page_table), ctx->mmu, ctx->page_table);
+        }
+        else if (live.size() < 500 || random_state % 2 == 0)
+        {
+            std::string name = "v" + std::to_string(next_name++);
+            allocateVariable(pid, name, Int, 1 + random_state % 256, ctx->mmu, ctx->page_table);
+            int value = (int)random_state;
+            setVariable(pid, name, 0, &value, ctx->mmu, ctx->page_table, ctx->memory);
+            live.push_back(name);
+        }
+        else
+        {
+            int index = random_state % live.size();
+            std::swap(live[index], live.back());
+            freeVariable(pid, live.back(), ctx->mmu, ctx->page_table);
+            live.pop_back();
+        }
+        latencies->push_back(elapsedNs(start));
+    }
+    terminateProcess(pid, ctx->mmu, ctx->page_table);
+}
+
+/** Runs the allocate/set/free churn of one process per thread, one thread per core (up to BENCH_MAX_THREADS). One op
+ *  is one allocate and set, one free, or one create and terminate.
+ */
+static void parallelChurn(BenchContext *ctx)
+{
+    int num_threads = std::max(1, std::min((int)std::thread::hardware_concurrency(), BENCH_MAX_THREADS));
+    std::vector<std::vector<uint64_t> > latencies(num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++)
+    {
+        threads.push_back(std::thread(parallelChurnWorker, ctx, 12345 + t, &latencies[t]));
+    }
+    for (int t = 0; t < num_threads; t++)
+    {
+        threads[t].join();
+        ctx->latencies.insert(ctx->latencies.end(), latencies[t].begin(), latencies[t].end());
+    }
+}
+
+/** Runs one scenario in a child process and prints its result line
+ * @param name Name of the scenario.
+ * @param scenario Function running the workload.
+ * @param page_size Page size to simulate.
+ * @param scale Multiplier for the amount of work.
+ */
+static void runScenario(const char *name, Scenario scenario, int page_size, int scale)
+{
+    fflush(stdout);
+    pid_t child = fork();
+    if (child != 0)
+    {
+        int status;
+        waitpid(child, &status, 0);
+        return;
+    }
+
+    BenchContext ctx;
+    ctx.page_size = page_size;
+    ctx.scale = scale;
+    ctx.memory = malloc(BENCH_MEMORY_SIZE);
+    ctx.mmu = new Mmu(BENCH_MEMORY_SIZE);
+    ctx.page_table = new PageTable(page_size, BENCH_MEMORY_SIZE / page_size);
+    ctx.page_table->setMemory(ctx.memory);
+
+    // Allocation failures print errors from the simulator, keep them out of the results
+    FILE *results = fdopen(dup(fileno(stdout)), "w");
+    freopen("/dev/null", "w", stdout);
+
+    Clock::time_point start = Clock::now();
+    scenario(&ctx);
+    double seconds = elapsedNs(start) / 1e9;
+
+    std::sort(ctx.latencies.begin(), ctx.latencies.end());
+    size_t ops = ctx.latencies.size();
+    uint64_t p50 = ops > 0 ? ctx.latencies[ops / 2] : 0;
+    uint64_t p99 = ops > 0 ? ctx.latencies[std::min(ops - 1, ops * 99 / 100)] : 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    FrameAllocator *frames = ctx.page_table->getFrameAllocator();
+
+    fprintf(results, "{\"scenario\":\"%s\",\"page_size\":%d,\"ops\":%zu,\"seconds\":%.6f,\"ops_per_sec\":%.1f,"
+            "\"p50_ns\":%llu,\"p99_ns\":%llu,\"peak_rss_kb\":%ld,\"frames_in_use\":%u}\n", name, page_size, ops, seconds,
+            seconds > 0 ? ops / seconds : 0.0, (unsigned long long)p50, (unsigned long long)p99, usage.ru_maxrss,
+            frames->getNumFrames() - frames->getNumFree());
+    fclose(results);
+    _exit(0);
+}
+
+int main(int argc, char **argv)
+{
+    int page_size = (argc > 1) ? atoi(argv[1]) : 4096;
+    int scale = (argc > 2) ? atoi(argv[2]) : 1;
+    const char *only = (argc > 3) ? argv[3] : NULL;
+
+    struct { const char *name; Scenario scenario; } scenarios[] = {
+        {"process_churn", processChurn},
+        {"small_object_churn", smallObjectChurnFreeSpace},
+        {"small_object_churn_slab", smallObjectChurnSlab},
+        {"large_array_allocation", largeArrayAllocation},
+        {"fork_churn", forkChurn},
+        {"dense_set", denseSet},
+        {"translation_reads", translationReads},
+        {"parallel_churn", parallelChurn},
+        {"mixed_churn_first_fit", mixedChurnFirstFit},
+        {"mixed_churn_next_fit", mixedChurnNextFit},
+        {"mixed_churn_best_fit", mixedChurnBestFit},
+        {"mixed_churn_worst_fit", mixedChurnWorstFit},
+        {"mixed_churn_buddy", mixedChurnBuddy},
+    };
+
+    for (int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        if (only == NULL || strcmp(only, scenarios[i].name) == 0)
+        {
+            runScenario(scenarios[i].name, scenarios[i].scenario, page_size, scale);
+        }
+    }
+    return 0;
+}
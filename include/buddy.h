@@ -0,0 +1,50 @@
+#ifndef __BUDDY_H_
+#define __BUDDY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "snapshot.h"
+#include "stats.h"
+
+// Block sizes are 2^order bytes, from BUDDY_MIN_ORDER up to 2^31
+#define BUDDY_MIN_ORDER 3
+#define BUDDY_ORDERS 32
+
+// Buddy system allocator for one process' virtual memory. Blocks are powers of two aligned to their own size, so a
+// block never straddles a page boundary unless it starts on one, and splitting or merging a block takes O(log n).
+class BuddyAllocator {
+private:
+    std::set<uint32_t> _free[BUDDY_ORDERS];                 // Start addresses of the free blocks of each order
+    std::unordered_map<uint32_t, uint8_t> _allocated;       // start address -> order of each allocated block
+    uint64_t _requested_bytes;
+    uint64_t _reserved_bytes;
+    uint32_t _probes;                                       // Orders examined by the last find
+
+    int findFreeOrder(int order);
+    static bool addBlock(std::map<uint32_t, uint64_t> *blocks, uint32_t address, int order, uint32_t limit);
+
+public:
+    BuddyAllocator();
+    ~BuddyAllocator();
+
+    void init(uint32_t size);
+    uint32_t find(uint32_t size);
+    bool reserve(uint32_t address, uint32_t size);
+    bool release(uint32_t address, uint32_t size);
+    uint64_t getRequestedBytes();
+    uint64_t getReservedBytes();
+    uint64_t getFreeBytes();
+    uint32_t getLargestFree();
+    uint32_t getLastProbes();
+    size_t getNumFree(int order);
+    bool overlaps(uint32_t address, uint32_t size);
+    void save(SnapshotWriter& writer);
+    bool load(SnapshotReader& reader, uint32_t limit);
+
+    static int getOrder(uint32_t size);
+};
+
+#endif // __BUDDY_H_
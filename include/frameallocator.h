@@ -0,0 +1,30 @@
+#ifndef __FRAMEALLOCATOR_H_
+#define __FRAMEALLOCATOR_H_
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+// Bitmap of physical frames. Safe to use from several threads at once.
+class FrameAllocator {
+private:
+    std::mutex _lock;
+    uint32_t _num_frames;
+    uint32_t _num_free;
+    uint32_t _hint;                 // Lowest bitmap word that may still contain a free frame
+    std::vector<uint64_t> _bitmap;  // One bit per frame, set if the frame is in use
+
+public:
+    FrameAllocator(uint32_t num_frames);
+    ~FrameAllocator();
+
+    int allocate();
+    void release(int frame);
+    bool isAllocated(int frame);
+    uint32_t getNumFrames();
+    uint32_t getNumFree();
+    bool reserve(int frame);
+    std::vector<int> getAllocated();
+};
+
+#endif // __FRAMEALLOCATOR_H_
@@ -0,0 +1,58 @@
+#ifndef __FREESPACE_H_
+#define __FREESPACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include "snapshot.h"
+#include "stats.h"
+
+// Extents are also binned by the position of the highest set bit of their size
+#define FREE_SPACE_BINS 32
+
+// Where a block is placed among the free extents that can hold it
+enum PlacementPolicy : uint8_t {FirstFit, NextFit, BestFit, WorstFit};
+
+// Free extents of one process' virtual memory, indexed both by start address and by size
+class FreeSpaceIndex {
+private:
+    std::map<uint32_t, uint32_t> _by_address;               // start address -> size
+    std::set<std::pair<uint32_t, uint32_t> > _by_size;      // (size, start address)
+    std::set<uint32_t> _bins[FREE_SPACE_BINS];              // Start addresses of the extents in each size bin
+    uint32_t _rover;                                        // Where the next next-fit search starts
+    uint64_t _free_bytes;
+    uint32_t _probes;                                       // Extents examined by the last search
+
+    static int getBin(uint32_t size);
+    uint32_t findFromAddress(uint32_t start, int size, int page_size, int num_elements);
+
+public:
+    FreeSpaceIndex();
+    ~FreeSpaceIndex();
+
+    void insert(uint32_t address, uint32_t size);
+    void erase(uint32_t address);
+    bool reserve(uint32_t address, uint32_t size);
+    void release(uint32_t address, uint32_t size);
+    uint32_t find(PlacementPolicy policy, int size, int page_size, int num_elements);
+    uint32_t findFirstFit(int size, int page_size, int num_elements);
+    uint32_t findNextFit(int size, int page_size, int num_elements);
+    uint32_t findBestFit(int size, int page_size, int num_elements);
+    uint32_t findWorstFit(int size, int page_size, int num_elements);
+    size_t count();
+    uint64_t getFreeBytes();
+    uint32_t getLargest();
+    uint32_t getLastProbes();
+    bool overlaps(uint32_t address, uint32_t size);
+    void save(SnapshotWriter& writer);
+    bool load(SnapshotReader& reader, uint32_t limit);
+
+    static bool parsePolicy(const std::string& name, PlacementPolicy *policy);
+    static const char* getPolicyName(PlacementPolicy policy);
+    static bool fitInExtent(uint32_t address, uint32_t extent_size, int size, int page_size, int num_elements, uint32_t *placement);
+};
+
+#endif // __FREESPACE_H_
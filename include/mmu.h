@@ -4,6 +4,22 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "freespace.h"
+#include "buddy.h"
+#include "slab.h"
+#include "pool.h"
+#include "snapshot.h"
+#include "stats.h"
+
+// Processes are spread over this many independently locked maps by PID
+#define MMU_PROCESS_SHARDS 16
+
+// How free virtual memory is tracked: a free extent list (placed by a PlacementPolicy) or a buddy system
+enum HeapBackend : uint8_t {FreeListHeap, BuddyHeap};
 
 enum DataType : uint8_t {FreeSpace, Char, Short, Int, Float, Long, Double};
 
@@ -16,17 +32,43 @@ typedef struct Variable {
 
 typedef struct Process {
     uint32_t pid;
-    std::vector<Variable*> variables;
+    std::multimap<uint32_t, Variable*> variables;   // Allocated variables, ordered by virtual address
+    std::unordered_map<std::string, Variable*> names;
+    ObjectPool<Variable> variable_pool;             // Arena for this process' Variable records
+    FreeSpaceIndex free_space;                      // Free extents, for the free list heap
+    BuddyAllocator buddy;                           // Free blocks, for the buddy heap
+    SlabAllocator slabs;                            // Pages carved into slots for single small elements
+    std::recursive_mutex lock;                      // Held by the thread operating on the process
+    uint32_t references;                            // Threads holding or waiting for the lock (guarded by the shard)
+    bool terminated;                                // Set once removed, the last reference frees the process
 } Process;
 
+typedef struct ProcessShard {
+    std::mutex lock;
+    std::unordered_map<uint32_t, Process*> processes;
+} ProcessShard;
+
 class Mmu {
 private:
-    uint32_t _next_pid;
+    std::atomic<uint32_t> _next_pid;
     uint32_t _max_size;
-    std::vector<Process*> _processes;
+    PlacementPolicy _placement;
+    HeapBackend _heap;
+    bool _slab_enabled;
+    int _compact_threshold;
+    ProcessShard _shards[MMU_PROCESS_SHARDS];
+    ObjectPool<Process> _process_pool;
+    std::mutex _pool_lock;
+
+    // Statistics, kept for the whole run (a loaded snapshot does not reset them)
+    Histogram _searches;                // Extents (or buddy orders) examined by each getFreeSpaceAnywhere
+    Counter _allocation_failures;       // getFreeSpaceAnywhere calls that found no space
+
+    ProcessShard& getShard(uint32_t pid);
+    void deleteProcess(Process *process);
 
 public:
-    Mmu(int memory_size);
+    Mmu(uint32_t memory_size);
     ~Mmu();
 
     uint32_t createProcess();
@@ -35,16 +77,36 @@ public:
 
     // CUSTOM FUNCTIONS
     Variable* getVariableByProcessAndName(Process* process, std::string name);
-    std::vector<Process*> getProcessesVector();
+    std::vector<uint32_t> getPIDs();
     Process* getProcessByPID(int pid);
-    std::vector<Variable*> getFreeSpaceVector(int pid);
-    uint32_t getFreeSpaceInPage(int pid, int page, int size, int page_size, int num_elements);
+    Process* acquireProcess(uint32_t pid);
+    void releaseProcess(Process *process);
     uint32_t getFreeSpaceAnywhere(int pid, int size, int page_size, int num_elements);
     void updateFreeSpace(int pid, int virtual_address, int size);
     bool removeVariable(int pid, std::string var_name);
     std::vector<int> getExclusivePages(int pid, std::string var_name, int page_size);
     bool variableExists(int pid, std::string var_name);
     void removeProcess(int pid);
+    void setPlacementPolicy(PlacementPolicy policy);
+    PlacementPolicy getPlacementPolicy();
+    void setHeapBackend(HeapBackend heap);
+    HeapBackend getHeapBackend();
+    void printFragmentation();
+    void setSlabEnabled(bool enabled);
+    bool isSlabEnabled();
+    uint32_t allocateFromSlab(int pid, int size, int page_size);
+    void freeSlabSlot(int pid, uint32_t virtual_address);
+    void moveVariable(int pid, Variable *variable, uint32_t virtual_address);
+    void rebuildFreeSpace(int pid);
+    int getHolePercent(int pid);
+    uint32_t forkProcess(uint32_t parent_pid);
+    void setCompactThreshold(int percent);
+    int getCompactThreshold();
+    void clear();
+    void save(SnapshotWriter& writer);
+    bool load(SnapshotReader& reader);
+    void printStats();
+    void writeStatsJson(FILE *file);
 };
 
 #endif // __MMU_H_
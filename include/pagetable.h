@@ -4,46 +4,149 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <map>
+#include <set>
 #include <algorithm>
+#include <mutex>
+#include <atomic>
+#include "frameallocator.h"
+#include "replacement.h"
+#include "swapfile.h"
+#include "tlb.h"
+#include "snapshot.h"
+#include "stats.h"
 
-struct PageTableKeyComparator
-{
-    inline bool operator() (const std::string& str1, const std::string& str2)
-    {
-        size_t sep1 = str1.find("|");
-        uint32_t pid1 = std::stoi(str1.substr(0, sep1));
-        int page1 = std::stoi(str1.substr(sep1 + 1));
-        size_t sep2 = str2.find("|");
-        uint32_t pid2 = std::stoi(str2.substr(0, sep2));
-        int page2 = std::stoi(str2.substr(sep2 + 1));
-
-        return (pid1 < pid2 || (pid1 == pid2 && page1 < page2));
-    }
-};
+// Page numbers are split into a directory index and a leaf index (two-level radix table)
+#define PAGE_TABLE_LEAF_BITS 10
+#define PAGE_TABLE_LEAF_SIZE (1 << PAGE_TABLE_LEAF_BITS)
+#define PAGE_TABLE_LEAF_MASK (PAGE_TABLE_LEAF_SIZE - 1)
+
+// Process page tables are spread over this many independently locked maps by PID
+#define PAGE_TABLE_SHARDS 16
+
+typedef struct PageTableEntry {
+    bool mapped;
+    int frame;          // Frame holding the page, -1 while the page is swapped out
+    int swap_slot;      // Slot holding a copy of the page in the swap file, -1 if there is none
+    bool shared;        // The frame belongs to a shared memory segment, not to the page
+} PageTableEntry;
+
+typedef struct ProcessPageTable {
+    std::vector<PageTableEntry*> directory;     // Leaves of PAGE_TABLE_LEAF_SIZE entries
+    uint32_t num_entries;
+} ProcessPageTable;
+
+typedef struct PageTableShard {
+    std::mutex lock;
+    std::unordered_map<uint32_t, ProcessPageTable*> tables;
+} PageTableShard;
+
+typedef struct FrameOwner {
+    uint32_t pid;
+    int page_number;
+} FrameOwner;
+
+// Named shared memory segment. Its frames are pinned (never evicted) and freed once the segment has been destroyed and
+// the last process has detached.
+typedef struct SharedSegment {
+    uint32_t size;                  // Bytes, a whole number of pages
+    std::vector<int> frames;
+    std::set<uint32_t> attached;    // PIDs the segment is mapped into
+    bool destroyed;
+} SharedSegment;
 
 class PageTable {
 private:
     int _page_size;
-    std::map<std::string, int> _table;
+    int _offset_size;
+    PageTableShard _shards[PAGE_TABLE_SHARDS];
+    FrameAllocator _frames;
+    std::vector<FrameOwner> _frame_owners;
+    std::vector<uint8_t> _frame_dirty;          // Bytes rather than bits so threads can mark different frames at once
+    Tlb *_tlb;
+
+    // Demand paging (only when enabled). Evictions touch other processes' pages, so paging is serialized by one lock.
+    std::recursive_mutex _pager_lock;
+    void *_memory;
+    ReplacementPolicy *_policy;
+    SwapFile *_swap;
+    uint64_t _page_faults;
+    uint64_t _evictions;
+    uint64_t _writebacks;
+
+    // Copy on write. Frames mapped by more than one page, with every page mapping them. Shared frames stay in the
+    // replacement policy, evicting one swaps out every page mapping it. The share lock is never held while taking a
+    // shard lock.
+    std::mutex _share_lock;
+    std::unordered_map<int, std::vector<FrameOwner> > _shared_frames;
+    std::atomic<uint32_t> _num_shared;                  // Size of _shared_frames, checked without the lock
+
+    // Shared memory segments by name. The segment lock may be held while taking a shard lock, never the other way round.
+    std::mutex _segment_lock;
+    std::map<std::string, SharedSegment*> _segments;
+
+    // Statistics, kept for the whole run (a loaded snapshot does not reset them)
+    Counter _translations;
+    Counter _translation_faults;        // Translations that failed: the page is unmapped or could not get a frame
+    Counter _frame_failures;            // Times no frame was free and none could be evicted
 
-    std::vector<std::string> sortedKeys();
+    PageTableShard& getShard(uint32_t pid);
+    ProcessPageTable* getProcessTable(uint32_t pid);
+    ProcessPageTable* findTable(uint32_t pid);
+    PageTableEntry* getEntry(uint32_t pid, int page_number);
+    PageTableEntry* findEntry(ProcessPageTable *table, int page_number);
+    PageTableEntry* createEntry(uint32_t pid, int page_number);
+    std::vector<int> findPages(ProcessPageTable *table);
+    std::vector<uint32_t> sortedPIDs();
+    int obtainFrame();
+    int evictFrame();
+    bool evictSharedFrame(int victim);
+    int loadPage(uint32_t pid, int page_number, PageTableEntry *entry);
+    void placePage(uint32_t pid, int page_number, int frame);
+    bool isShared(int frame);
+    bool unshareFrame(int frame, uint32_t pid, int page_number);
+    int copyOnWrite(uint32_t pid, int page_number, int frame);
+    void freeSegment(std::map<std::string, SharedSegment*>::iterator it);
 
 public:
-    PageTable(int page_size);
+    PageTable(int page_size, uint32_t num_frames);
     ~PageTable();
 
-    void addEntry(uint32_t pid, int page_number);
-    int getPhysicalAddress(uint32_t pid, uint32_t virtual_address);
+    int addEntry(uint32_t pid, int page_number);
+    int64_t getPhysicalAddress(uint32_t pid, uint32_t virtual_address);
     void print();
 
     // CUSTOM
-    std::vector<std::string> getAllPagesForPID(uint32_t pid);
+    int64_t getPhysicalAddress(uint32_t pid, uint32_t virtual_address, bool write);
+    std::vector<int> getAllPagesForPID(uint32_t pid);
     int getPageSize();
     int getOffsetSize();
+    FrameAllocator* getFrameAllocator();
+    void enableTlb(uint32_t num_entries, uint32_t ways, TlbReplacement replacement, bool tag_pids);
+    Tlb* getTlb();
+    bool enableDemandPaging(void *memory, const std::string& policy_name, const std::string& swap_path);
+    void printPagingStats();
+    std::unique_lock<std::recursive_mutex> lockPager();
     bool entryExists(uint32_t pid, int page_number);
     void removeEntry(uint32_t pid, int page_number);
-    void removeEntry(std::string entry);
+    int compactFrames(uint32_t pid, void *memory);
+    void setMemory(void *memory);
+    bool forkEntries(uint32_t parent_pid, uint32_t child_pid);
+    uint32_t getNumSharedFrames();
+    bool createSegment(const std::string& name, uint32_t size);
+    bool destroySegment(const std::string& name);
+    uint32_t getSegmentSize(const std::string& name);
+    bool attachSegment(uint32_t pid, const std::string& name, uint32_t virtual_address);
+    bool detachSegment(uint32_t pid, const std::string& name, uint32_t virtual_address);
+    void detachAllSegments(uint32_t pid);
+    bool isAttached(uint32_t pid, const std::string& name);
+    void printSegments();
+    void clear();
+    void save(SnapshotWriter& writer);
+    bool load(SnapshotReader& reader);
+    void printStats();
+    void writeStatsJson(FILE *file);
 };
 
 #endif // __PAGETABLE_H_
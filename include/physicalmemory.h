@@ -0,0 +1,26 @@
+#ifndef __PHYSICALMEMORY_H_
+#define __PHYSICALMEMORY_H_
+
+#include <cstdint>
+#include <string>
+
+// Simulated physical memory, mapped with mmap so the host only commits the pages that are actually touched.
+// Backed by anonymous memory, or by a file so its contents survive a restart.
+class PhysicalMemory {
+private:
+    void *_data;
+    uint64_t _size;
+    int _fd;
+
+public:
+    PhysicalMemory();
+    ~PhysicalMemory();
+
+    bool map(uint64_t size, const std::string& path);
+    void* getData();
+    uint64_t getSize();
+    bool isPersistent();
+    bool mapFile(int fd, uint64_t offset);
+};
+
+#endif // __PHYSICALMEMORY_H_
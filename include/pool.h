@@ -0,0 +1,98 @@
+#ifndef __POOL_H_
+#define __POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#define POOL_FIRST_SLAB_SLOTS 16
+#define POOL_MAX_SLAB_SLOTS 4096
+
+// Slab allocator for fixed-size records. Slots are carved from slabs that grow geometrically, released slots are
+// reused through a free list, and all slabs are returned to the heap at once when the pool is destroyed.
+template <typename T>
+class ObjectPool {
+private:
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<Slot*> _slabs;
+    Slot *_free_list;
+    uint32_t _slab_slots;       // Number of slots in the newest slab
+    uint32_t _next_unused;      // Index of the first never-used slot in the newest slab
+    size_t _live;
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+public:
+    ObjectPool()
+    {
+        _free_list = NULL;
+        _slab_slots = 0;
+        _next_unused = 0;
+        _live = 0;
+    }
+
+    // Objects still alive are not destructed, their owner must destroy() any that hold resources
+    ~ObjectPool()
+    {
+        for (size_t i = 0; i < _slabs.size(); i++)
+        {
+            delete[] _slabs[i];
+        }
+    }
+
+    /** Constructs a new object in a free slot
+     * @return Pointer to the new object.
+     */
+    T* create()
+    {
+        Slot *slot = _free_list;
+        if (slot != NULL)
+        {
+            _free_list = slot->next;
+        }
+        else
+        {
+            if (_next_unused == _slab_slots)
+            {
+                _slab_slots = (_slab_slots == 0) ? POOL_FIRST_SLAB_SLOTS : _slab_slots * 2;
+                if (_slab_slots > POOL_MAX_SLAB_SLOTS)
+                {
+                    _slab_slots = POOL_MAX_SLAB_SLOTS;
+                }
+                _slabs.push_back(new Slot[_slab_slots]);
+                _next_unused = 0;
+            }
+            slot = &_slabs.back()[_next_unused++];
+        }
+        _live++;
+        return new (slot->storage) T();
+    }
+
+    /** Destructs an object and returns its slot to the pool
+     * @param object Pointer to an object created by this pool.
+     */
+    void destroy(T *object)
+    {
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot*>(object);
+        slot->next = _free_list;
+        _free_list = slot;
+        _live--;
+    }
+
+    /** Gets the number of objects currently alive
+     * @return Number of live objects.
+     */
+    size_t live()
+    {
+        return _live;
+    }
+};
+
+#endif // __POOL_H_
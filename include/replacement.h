@@ -0,0 +1,104 @@
+#ifndef __REPLACEMENT_H_
+#define __REPLACEMENT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Picks which physical frame to evict when demand paging runs out of free frames. The page table reports every frame
+// that gets a page, every access to a frame and every frame that is emptied.
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() {}
+
+    virtual void frameLoaded(int frame) = 0;
+    virtual void frameAccessed(int frame) = 0;
+    virtual void frameReleased(int frame) = 0;
+    virtual int selectVictim() = 0;
+    virtual const char* getName() = 0;
+
+    static ReplacementPolicy* create(const std::string& name, uint32_t num_frames);
+};
+
+// Doubly linked list threaded through per-frame arrays, so queue operations never allocate
+class FrameQueue {
+private:
+    std::vector<int> _prev;
+    std::vector<int> _next;
+    std::vector<bool> _queued;
+    int _head;
+    int _tail;
+
+public:
+    FrameQueue(uint32_t num_frames);
+
+    void pushBack(int frame);
+    void remove(int frame);
+    int front();
+    bool contains(int frame);
+};
+
+// Evicts the frame that was loaded first
+class FifoPolicy : public ReplacementPolicy {
+private:
+    FrameQueue _queue;
+
+public:
+    FifoPolicy(uint32_t num_frames);
+
+    void frameLoaded(int frame);
+    void frameAccessed(int frame);
+    void frameReleased(int frame);
+    int selectVictim();
+    const char* getName();
+};
+
+// Evicts the frame that was accessed least recently
+class LruPolicy : public ReplacementPolicy {
+private:
+    FrameQueue _queue;
+
+public:
+    LruPolicy(uint32_t num_frames);
+
+    void frameLoaded(int frame);
+    void frameAccessed(int frame);
+    void frameReleased(int frame);
+    int selectVictim();
+    const char* getName();
+};
+
+// Sweeps a hand over all frames, clearing reference bits until it finds a frame that was not referenced
+class ClockPolicy : public ReplacementPolicy {
+private:
+    std::vector<bool> _loaded;
+    std::vector<bool> _referenced;
+    uint32_t _hand;
+
+public:
+    ClockPolicy(uint32_t num_frames);
+
+    void frameLoaded(int frame);
+    void frameAccessed(int frame);
+    void frameReleased(int frame);
+    int selectVictim();
+    const char* getName();
+};
+
+// FIFO order, but a frame referenced since it reached the front is moved to the back instead of being evicted
+class SecondChancePolicy : public ReplacementPolicy {
+private:
+    FrameQueue _queue;
+    std::vector<bool> _referenced;
+
+public:
+    SecondChancePolicy(uint32_t num_frames);
+
+    void frameLoaded(int frame);
+    void frameAccessed(int frame);
+    void frameReleased(int frame);
+    int selectVictim();
+    const char* getName();
+};
+
+#endif // __REPLACEMENT_H_
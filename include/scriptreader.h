@@ -0,0 +1,28 @@
+#ifndef __SCRIPTREADER_H_
+#define __SCRIPTREADER_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define SCRIPT_READER_BUFFER_SIZE (1 << 20)
+
+// Reads a command file line by line through a large read buffer
+class ScriptReader {
+private:
+    FILE *_file;
+    std::vector<char> _buffer;
+    size_t _position;
+    size_t _end;
+
+    bool fill();
+
+public:
+    ScriptReader();
+    ~ScriptReader();
+
+    bool open(const std::string& path);
+    bool nextLine(std::string& line);
+};
+
+#endif // __SCRIPTREADER_H_
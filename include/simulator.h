@@ -0,0 +1,42 @@
+#ifndef __SIMULATOR_H_
+#define __SIMULATOR_H_
+
+#include <cstdio>
+#include <string>
+#include "mmu.h"
+#include "pagetable.h"
+
+// Variables are dumped through a buffer of this many bytes
+#define DUMP_BUFFER_SIZE (1 << 16)
+
+// What compacting a process did
+typedef struct CompactionResult {
+    uint32_t variables_moved;
+    uint64_t bytes_moved;
+    uint32_t pages_reclaimed;
+    uint32_t frames_moved;
+} CompactionResult;
+
+// Simulator operations shared by the command loop and the benchmarks. Each operation locks the process it works on, so
+// operations on different processes can run on different threads. Functions taking a Variable* expect the caller to
+// hold the variable's process (Mmu::acquireProcess).
+uint32_t createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table);
+int allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table);
+void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory);
+void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table);
+void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table);
+uint32_t forkProcess(uint32_t pid, Mmu *mmu, PageTable *page_table);
+int attachSegment(uint32_t pid, std::string name, Mmu *mmu, PageTable *page_table);
+bool detachSegment(uint32_t pid, std::string name, Mmu *mmu, PageTable *page_table);
+
+// CUSTOM FUNCTIONS
+void setVariableElement(uint32_t pid, Variable *variable, uint32_t offset, void *value, PageTable *page_table, void *memory);
+bool setVariableElements(uint32_t pid, Variable *variable, uint32_t offset, const void *values, uint32_t count, PageTable *page_table, void *memory);
+bool readVariableElements(uint32_t pid, Variable *variable, uint32_t offset, void *buffer, uint32_t count, PageTable *page_table, void *memory);
+bool dumpVariable(uint32_t pid, Variable *variable, const std::string& path, bool text, PageTable *page_table, void *memory);
+void printElement(FILE *file, DataType type, const void *value);
+int getDataTypeSize(DataType type);
+DataType stringToDataType(std::string input);
+bool compactProcess(uint32_t pid, Mmu *mmu, PageTable *page_table, void *memory, CompactionResult *result);
+
+#endif // __SIMULATOR_H_
@@ -0,0 +1,56 @@
+#ifndef __SLAB_H_
+#define __SLAB_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include "snapshot.h"
+
+// Single elements of 1, 2, 4 and 8 bytes are served from slabs, one size class per power of two
+#define SLAB_CLASSES 4
+#define SLAB_MAX_SIZE (1 << (SLAB_CLASSES - 1))
+
+typedef struct Slab {
+    uint32_t address;                   // Start of the page the slab occupies
+    int size_class;
+    uint32_t capacity;                  // Number of slots in the page
+    uint32_t used;
+    uint32_t hint;                      // No word below this one has a free slot
+    int partial_index;                  // Position in its class' partial list, -1 while full
+    std::vector<uint64_t> bitmap;       // One bit per slot, set while the slot is in use
+} Slab;
+
+// Size-class slabs for one process. Each slab is one whole page carved into equally sized slots, so a small element
+// is placed without searching the free space, and a page goes back to the heap once its last slot is freed.
+class SlabAllocator {
+private:
+    uint32_t _page_size;
+    std::vector<Slab*> _partial[SLAB_CLASSES];          // Slabs with at least one free slot, per size class
+    std::unordered_map<uint32_t, Slab*> _slabs;         // page start address -> slab
+    uint64_t _used_bytes;
+
+    void removePartial(Slab *slab);
+
+public:
+    SlabAllocator();
+    SlabAllocator(const SlabAllocator& other);
+    ~SlabAllocator();
+    SlabAllocator& operator=(const SlabAllocator& other);
+
+    uint32_t allocate(int size);
+    void addSlab(int size, uint32_t address, uint32_t page_size);
+    uint32_t release(uint32_t address);
+    bool contains(uint32_t address);
+    uint64_t getUsedBytes();
+    uint64_t getSlabBytes();
+    size_t getNumSlabs();
+    uint32_t getPageSize();
+    void save(SnapshotWriter& writer);
+    bool load(SnapshotReader& reader);
+
+    static int getSizeClass(int size);
+};
+
+#endif // __SLAB_H_
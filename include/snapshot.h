@@ -0,0 +1,73 @@
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Snapshot files start with this magic (including its terminating zero) and a format version, which is bumped whenever
+// the layout changes
+#define SNAPSHOT_MAGIC "MEMSNAP"
+#define SNAPSHOT_MAGIC_SIZE 8
+#define SNAPSHOT_VERSION 1
+
+// The frame region starts on a multiple of this, so it can be mapped on hosts with pages of up to 64 KB
+#define SNAPSHOT_ALIGNMENT 65536
+
+// Longest string a snapshot may hold, so a corrupt length cannot exhaust memory
+#define SNAPSHOT_MAX_STRING (1 << 20)
+
+class Mmu;
+class PageTable;
+class PhysicalMemory;
+
+// Writes the metadata of a snapshot: fixed size values in host byte order, and length-prefixed strings. Errors are
+// sticky, so a sequence of writes is checked once at the end.
+class SnapshotWriter {
+private:
+    FILE *_file;
+    bool _ok;
+
+public:
+    SnapshotWriter(FILE *file);
+
+    void write(const void *data, size_t size);
+    void putString(const std::string& value);
+    bool ok();
+
+    template <typename T>
+    void put(T value)
+    {
+        write(&value, sizeof(T));
+    }
+};
+
+// Reads what a SnapshotWriter wrote. Once a read fails (or the caller rejects a value with fail) every later read
+// returns zeros, so loops bounded by a count read from the file also check ok.
+class SnapshotReader {
+private:
+    FILE *_file;
+    bool _ok;
+
+public:
+    SnapshotReader(FILE *file);
+
+    void read(void *data, size_t size);
+    std::string getString();
+    void fail();
+    bool ok();
+
+    template <typename T>
+    T get()
+    {
+        T value = T();
+        read(&value, sizeof(T));
+        return value;
+    }
+};
+
+bool saveSnapshot(const std::string& path, Mmu *mmu, PageTable *page_table, PhysicalMemory *memory);
+bool loadSnapshot(const std::string& path, Mmu *mmu, PageTable *page_table, PhysicalMemory *memory);
+
+#endif // __SNAPSHOT_H_
@@ -0,0 +1,83 @@
+#ifndef __STATS_H_
+#define __STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <atomic>
+
+// Building with -DMEMSIM_NO_STATS (make NO_STATS=1) drops every statement wrapped in STATS, so the counters cost
+// nothing; they are still printed, but stay at zero
+#ifdef MEMSIM_NO_STATS
+#define STATS_ENABLED false
+#define STATS(statement)
+#else
+#define STATS_ENABLED true
+#define STATS(statement) statement
+#endif
+
+// Values are counted in power of two buckets: bucket 0 holds 0 and bucket i holds [2^(i-1), 2^i)
+#define STATS_BUCKETS 65
+
+// Commands timed by CommandStats, as typed at the prompt; anything else is counted as "other"
+#define STATS_COMMANDS 16
+
+// Event counter that threads update without waiting on each other
+class Counter {
+private:
+    std::atomic<uint64_t> _value;
+
+public:
+    Counter();
+
+    void add(uint64_t amount = 1);
+    uint64_t get();
+    void clear();
+};
+
+// Distribution of a value (a latency or a search length) kept in log2 buckets, so recording is a few relaxed atomic
+// updates and percentiles are accurate to within a factor of two
+class Histogram {
+private:
+    std::atomic<uint64_t> _buckets[STATS_BUCKETS];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+
+public:
+    Histogram();
+
+    void record(uint64_t value);
+    void clear();
+    uint64_t getCount();
+    double getMean();
+    uint64_t getMax();
+    uint64_t getPercentile(double percent);
+    void print(const char *name, const char *unit, double scale);
+    void writeJson(FILE *file, double scale);
+};
+
+// Number and latency of the commands run, by command
+class CommandStats {
+private:
+    Histogram _latency[STATS_COMMANDS];     // Nanoseconds
+    std::string _output_path;
+    uint64_t _output_interval;
+    uint64_t _since_output;
+
+public:
+    CommandStats();
+
+    void record(int command, uint64_t ns);
+    void print();
+    void writeJson(FILE *file);
+    void setOutput(const std::string& path, uint64_t interval);
+    const std::string& getOutputPath();
+    bool isOutputDue();
+
+    static int getCommand(const char *name, size_t length);
+    static const char* getName(int command);
+};
+
+#endif // __STATS_H_
@@ -0,0 +1,28 @@
+#ifndef __SWAPFILE_H_
+#define __SWAPFILE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Backing store for evicted pages: a file divided into page sized slots
+class SwapFile {
+private:
+    int _fd;
+    int _page_size;
+    uint32_t _num_slots;
+    std::vector<int> _free_slots;
+
+public:
+    SwapFile(int page_size);
+    ~SwapFile();
+
+    bool open(const std::string& path);
+    int allocateSlot();
+    void releaseSlot(int slot);
+    bool writePage(int slot, const void *data);
+    bool readPage(int slot, void *data);
+    uint32_t getSlotsInUse();
+};
+
+#endif // __SWAPFILE_H_
@@ -0,0 +1,60 @@
+#ifndef __TLB_H_
+#define __TLB_H_
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+enum TlbReplacement : uint8_t {TlbLru, TlbRandom};
+
+typedef struct TlbEntry {
+    bool valid;
+    uint32_t pid;
+    uint32_t page;
+    int frame;
+    uint64_t last_used;
+} TlbEntry;
+
+typedef struct TlbSet {
+    std::mutex lock;
+    uint64_t clock;             // Last use stamp handed out in this set
+    uint32_t random_state;
+} TlbSet;
+
+// Each set has its own lock, so threads translating pages of different sets never wait for each other. An untagged
+// TLB is one shared context, so lookups and inserts also take a lock that covers switching PIDs.
+class Tlb {
+private:
+    uint32_t _num_sets;
+    uint32_t _ways;
+    TlbReplacement _replacement;
+    bool _tag_pids;             // If false, entries are not tagged and the TLB is flushed whenever the PID changes
+    uint32_t _current_pid;
+    std::mutex _switch_lock;
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+    std::atomic<uint64_t> _flushes;
+    std::vector<TlbEntry> _entries;
+    TlbSet *_sets;
+
+    TlbEntry* getSet(uint32_t page);
+    TlbSet& getSetState(uint32_t page);
+    void switchProcess(uint32_t pid);
+
+public:
+    Tlb(uint32_t num_entries, uint32_t ways, TlbReplacement replacement, bool tag_pids);
+    ~Tlb();
+
+    int lookup(uint32_t pid, uint32_t page);
+    void insert(uint32_t pid, uint32_t page, int frame);
+    void invalidate(uint32_t pid, uint32_t page);
+    void flush();
+    void print(int page_size);
+
+    uint64_t getHits();
+    uint64_t getMisses();
+    double getHitRate();
+};
+
+#endif // __TLB_H_
@@ -0,0 +1,24 @@
+#ifndef __TOKENIZER_H_
+#define __TOKENIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// View of one argument inside a command line. Only valid while the line it was split from is alive and unchanged.
+typedef struct Token {
+    const char *data;
+    size_t length;
+
+    bool equals(const char *text) const;
+    std::string str() const;
+} Token;
+
+void tokenize(const std::string& text, char d, std::vector<Token>& result);
+bool parseLong(const Token& token, long *value);
+bool parseUnsigned(const Token& token, uint32_t *value);
+bool parseDouble(const Token& token, double *value);
+bool parseFloat(const Token& token, float *value);
+
+#endif // __TOKENIZER_H_
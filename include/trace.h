@@ -0,0 +1,95 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Trace files start with this magic (including its terminating zero), a format version and the page size
+#define TRACE_MAGIC "MEMTRACE"
+#define TRACE_MAGIC_SIZE 9
+#define TRACE_VERSION 1
+
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+// Longest name or set payload a trace may hold, so a corrupt length cannot exhaust memory
+#define TRACE_MAX_LENGTH (1 << 30)
+
+// One executed command. Each opcode is followed by its operands as variable length integers; strings are interned, a
+// TraceName record gives a string the next id the first time it is used and later records only hold the id.
+enum TraceOp : uint8_t {
+    TraceName,          // length, characters
+    TraceCreate,        // text size, data size
+    TraceAllocate,      // pid, name, type, number of elements
+    TraceSet,           // pid, name, offset, type, number of values, the values as raw bytes
+    TraceFree,          // pid, name
+    TraceTerminate,     // pid
+    TraceFork,          // pid
+    TraceCompact,       // pid
+    TraceCompactAll,
+    TraceShmCreate,     // name, size
+    TraceShmDestroy,    // name
+    TraceShmAttach,     // pid, name
+    TraceShmDetach,     // pid, name
+    TraceDump,          // "<PID>:<var_name>", path, 1 for text or 0 for binary
+    TracePrint,         // object
+    TraceSave,          // path
+    TraceLoad,          // path
+    TRACE_OPS
+};
+
+// Appends executed commands to a trace file
+class TraceWriter {
+private:
+    FILE *_file;
+    std::vector<uint8_t> _buffer;
+    std::unordered_map<std::string, uint32_t> _names;
+    bool _ok;
+
+    void flush();
+
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool open(const std::string& path, uint32_t page_size);
+    bool close();
+    uint32_t intern(const std::string& name);
+    void putOp(TraceOp op);
+    void putVarint(uint64_t value);
+    void putBytes(const void *data, size_t size);
+};
+
+// Reads a trace file one command at a time, resolving interned strings
+class TraceReader {
+private:
+    FILE *_file;
+    std::vector<uint8_t> _buffer;
+    size_t _position;
+    size_t _end;
+    std::vector<std::string> _names;
+    std::vector<char> _payload;
+    bool _ok;
+
+    bool fill();
+    uint8_t getByte();
+
+public:
+    TraceReader();
+    ~TraceReader();
+
+    bool open(const std::string& path, uint32_t *page_size);
+    bool nextOp(TraceOp *op);
+    uint64_t getVarint();
+    const std::string& getName();
+    const char* getBytes(size_t size);
+    void fail();
+    bool ok();
+
+    static const char* getOpName(TraceOp op);
+};
+
+#endif // __TRACE_H_
@@ -0,0 +1,327 @@
+#include "buddy.h"
+#include <algorithm>
+
+BuddyAllocator::BuddyAllocator()
+{
+    _requested_bytes = 0;
+    _reserved_bytes = 0;
+    _probes = 0;
+}
+
+BuddyAllocator::~BuddyAllocator()
+{
+}
+
+/** Makes a region starting at address 0 free, as the largest aligned blocks that cover it
+ * @param size Size of the region in bytes. A tail smaller than the smallest block is left unused.
+ */
+void BuddyAllocator::init(uint32_t size)
+{
+    uint64_t address = 0;
+    while (address + (1ULL << BUDDY_MIN_ORDER) <= size)
+    {
+        int order = BUDDY_ORDERS - 1;
+        while (address % (1ULL << order) != 0 || address + (1ULL << order) > size)
+        {
+            order--;
+        }
+        _free[order].insert((uint32_t)address);
+        address += 1ULL << order;
+    }
+}
+
+/** Finds the block a new allocation would be given: the lowest addressed block of the smallest order with a free
+ *  block that can hold it
+ * @param size Size of the allocation in bytes.
+ * @return Start address of the block. -1 if no free block is large enough.
+ */
+uint32_t BuddyAllocator::find(uint32_t size)
+{
+    int wanted = getOrder(size);
+    int order = findFreeOrder(wanted);
+    STATS(_probes = (order == -1) ? std::max(BUDDY_ORDERS - wanted, 0) : order + 1 - wanted);
+    if (order == -1)
+    {
+        return -1;
+    }
+    return *_free[order].begin();
+}
+
+/** Allocates the block returned by find, splitting larger blocks down to the order the allocation needs
+ * @param address Start address returned by find.
+ * @param size Size of the allocation in bytes.
+ * @return True if the block was allocated. False if it is not the block find would return.
+ */
+bool BuddyAllocator::reserve(uint32_t address, uint32_t size)
+{
+    int wanted = getOrder(size);
+    int order = findFreeOrder(wanted);
+    if (order == -1 || *_free[order].begin() != address)
+    {
+        return false;
+    }
+    _free[order].erase(_free[order].begin());
+
+    // Keep the lower half each time, freeing the upper half (the buddy)
+    while (order > wanted)
+    {
+        order--;
+        _free[order].insert(address + (1U << order));
+    }
+
+    _allocated[address] = (uint8_t)order;
+    _requested_bytes += size;
+    _reserved_bytes += 1ULL << order;
+    return true;
+}
+
+/** Frees an allocated block, merging it with its buddy for as long as the buddy is free too
+ * @param address Start address of the block.
+ * @param size Size that was requested for the block.
+ * @return True if the block was allocated. False otherwise.
+ */
+bool BuddyAllocator::release(uint32_t address, uint32_t size)
+{
+    std::unordered_map<uint32_t, uint8_t>::iterator it = _allocated.find(address);
+    if (it == _allocated.end())
+    {
+        return false;
+    }
+    int order = it->second;
+    _allocated.erase(it);
+    _requested_bytes -= size;
+    _reserved_bytes -= 1ULL << order;
+
+    while (order < BUDDY_ORDERS - 1)
+    {
+        uint32_t buddy = address ^ (1U << order);
+        std::set<uint32_t>::iterator free_buddy = _free[order].find(buddy);
+        if (free_buddy == _free[order].end())
+        {
+            break;
+        }
+        _free[order].erase(free_buddy);
+        address &= ~(1U << order);
+        order++;
+    }
+    _free[order].insert(address);
+    return true;
+}
+
+/** Gets the number of bytes requested by the allocations currently held
+ * @return Sum of the requested sizes.
+ */
+uint64_t BuddyAllocator::getRequestedBytes()
+{
+    return _requested_bytes;
+}
+
+/** Gets the number of bytes in the blocks currently allocated. The difference from the requested bytes is internal
+ *  fragmentation.
+ * @return Sum of the allocated block sizes.
+ */
+uint64_t BuddyAllocator::getReservedBytes()
+{
+    return _reserved_bytes;
+}
+
+/** Gets the number of bytes in free blocks
+ * @return Sum of the free block sizes.
+ */
+uint64_t BuddyAllocator::getFreeBytes()
+{
+    uint64_t bytes = 0;
+    for (int order = 0; order < BUDDY_ORDERS; order++)
+    {
+        bytes += (uint64_t)_free[order].size() << order;
+    }
+    return bytes;
+}
+
+/** Gets the size of the largest free block
+ * @return Size of the largest free block in bytes, 0 if there is none.
+ */
+uint32_t BuddyAllocator::getLargestFree()
+{
+    for (int order = BUDDY_ORDERS - 1; order >= 0; order--)
+    {
+        if (!_free[order].empty())
+        {
+            return 1U << order;
+        }
+    }
+    return 0;
+}
+
+/** Gets the number of orders the last find examined
+ * @return Number of orders, always 0 if built with MEMSIM_NO_STATS.
+ */
+uint32_t BuddyAllocator::getLastProbes()
+{
+    return _probes;
+}
+
+/** Gets the number of free blocks of an order
+ * @param order The order.
+ * @return Number of free blocks of 2^order bytes.
+ */
+size_t BuddyAllocator::getNumFree(int order)
+{
+    return _free[order].size();
+}
+
+/** Checks whether a block shares any byte with a free block
+ * @param address Start address of the block.
+ * @param size Size of the block in bytes. An empty block overlaps nothing.
+ * @return True if part of the block is free. False otherwise.
+ */
+bool BuddyAllocator::overlaps(uint32_t address, uint32_t size)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+    uint32_t last = (uint32_t)((uint64_t)address + size - 1);
+    for (int order = 0; order < BUDDY_ORDERS; order++)
+    {
+        // The only free block of this order that can overlap is the last one starting at or before the block's end
+        std::set<uint32_t>::iterator it = _free[order].upper_bound(last);
+        if (it != _free[order].begin() && *(--it) + (1ULL << order) > address)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Writes the free and allocated blocks to a snapshot
+ * @param writer Snapshot being written.
+ */
+void BuddyAllocator::save(SnapshotWriter& writer)
+{
+    writer.put<uint64_t>(_requested_bytes);
+    writer.put<uint64_t>(_reserved_bytes);
+    for (int order = 0; order < BUDDY_ORDERS; order++)
+    {
+        writer.put<uint32_t>(_free[order].size());
+        std::set<uint32_t>::iterator it;
+        for (it = _free[order].begin(); it != _free[order].end(); it++)
+        {
+            writer.put<uint32_t>(*it);
+        }
+    }
+    writer.put<uint32_t>(_allocated.size());
+    std::unordered_map<uint32_t, uint8_t>::iterator it;
+    for (it = _allocated.begin(); it != _allocated.end(); it++)
+    {
+        writer.put<uint32_t>(it->first);
+        writer.put<uint8_t>(it->second);
+    }
+}
+
+/** Reads the blocks written by save into an allocator that was never initialized
+ * @param reader Snapshot being read.
+ * @param limit Size of the region the blocks were carved from, starting at address 0.
+ * @return True if the blocks were read. False if the snapshot is truncated, or holds an invalid order, a block that is
+ *  not aligned to its size or lies past the limit, two blocks that overlap or reserved bytes that do not add up.
+ */
+bool BuddyAllocator::load(SnapshotReader& reader, uint32_t limit)
+{
+    // End address of every block, free or allocated, by start address
+    std::map<uint32_t, uint64_t> blocks;
+    _requested_bytes = reader.get<uint64_t>();
+    _reserved_bytes = reader.get<uint64_t>();
+    for (int order = 0; order < BUDDY_ORDERS && reader.ok(); order++)
+    {
+        uint32_t count = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < count && reader.ok(); i++)
+        {
+            uint32_t address = reader.get<uint32_t>();
+            if (!addBlock(&blocks, address, order, limit))
+            {
+                reader.fail();
+                break;
+            }
+            _free[order].insert(address);
+        }
+    }
+    uint64_t reserved_bytes = 0;
+    uint32_t count = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < count && reader.ok(); i++)
+    {
+        uint32_t address = reader.get<uint32_t>();
+        uint8_t order = reader.get<uint8_t>();
+        if (!addBlock(&blocks, address, order, limit))
+        {
+            reader.fail();
+            break;
+        }
+        _allocated[address] = order;
+        reserved_bytes += 1ULL << order;
+    }
+    if (reserved_bytes != _reserved_bytes)
+    {
+        reader.fail();
+    }
+
+    // Blocks are sorted by start address, so each must end before the next one starts
+    uint64_t end = 0;
+    std::map<uint32_t, uint64_t>::iterator it;
+    for (it = blocks.begin(); it != blocks.end() && reader.ok(); it++)
+    {
+        if (it->first < end)
+        {
+            reader.fail();
+        }
+        end = it->second;
+    }
+    return reader.ok();
+}
+
+/** Records a block read from a snapshot, checking it could have been handed out by the allocator
+ * @param blocks End address of the blocks read so far, by start address.
+ * @param address Start address of the block.
+ * @param order Order of the block.
+ * @param limit Size of the region the blocks were carved from.
+ * @return True if the block is valid. False if its order is out of range, it is not aligned to its size, it lies past
+ *  the limit or another block starts at the same address.
+ */
+bool BuddyAllocator::addBlock(std::map<uint32_t, uint64_t> *blocks, uint32_t address, int order, uint32_t limit)
+{
+    uint64_t size = 1ULL << order;
+    if (order < BUDDY_MIN_ORDER || order >= BUDDY_ORDERS || address % size != 0 || address + size > limit)
+    {
+        return false;
+    }
+    return blocks->insert(std::make_pair(address, address + size)).second;
+}
+
+/** Gets the order of the smallest block that can hold an allocation
+ * @param size Size of the allocation in bytes.
+ * @return The order, at least BUDDY_MIN_ORDER.
+ */
+int BuddyAllocator::getOrder(uint32_t size)
+{
+    int order = BUDDY_MIN_ORDER;
+    while (order < BUDDY_ORDERS && (1ULL << order) < size)
+    {
+        order++;
+    }
+    return order;
+}
+
+/** Finds the smallest order, at or above the one given, that has a free block
+ * @param order The smallest order that can hold the allocation.
+ * @return The order, or -1 if no block is free at or above it.
+ */
+int BuddyAllocator::findFreeOrder(int order)
+{
+    for (; order < BUDDY_ORDERS; order++)
+    {
+        if (!_free[order].empty())
+        {
+            return order;
+        }
+    }
+    return -1;
+}
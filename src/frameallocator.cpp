@@ -0,0 +1,134 @@
+#include "frameallocator.h"
+
+FrameAllocator::FrameAllocator(uint32_t num_frames)
+{
+    _num_frames = num_frames;
+    _num_free = num_frames;
+    _hint = 0;
+    _bitmap.resize((num_frames + 63) / 64, 0);
+
+    // Mark the bits past the last frame as used so they are never handed out
+    if (num_frames % 64 != 0)
+    {
+        _bitmap.back() = ~0ULL << (num_frames % 64);
+    }
+}
+
+FrameAllocator::~FrameAllocator()
+{
+}
+
+/** Allocates the lowest numbered free frame
+ * @return The allocated frame number, or -1 if every frame is in use.
+ */
+int FrameAllocator::allocate()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+
+    // Every word below the hint is full, so the first free bit from the hint onwards is the lowest free frame
+    for (uint32_t word = _hint; word < _bitmap.size(); word++)
+    {
+        if (_bitmap[word] != ~0ULL)
+        {
+            int bit = __builtin_ctzll(~_bitmap[word]);
+            _bitmap[word] |= (1ULL << bit);
+            _num_free--;
+            _hint = word;
+            return (int)(word * 64 + bit);
+        }
+    }
+    _hint = _bitmap.size();
+    return -1;
+}
+
+/** Returns a frame to the free pool
+ * @param frame Frame number to release.
+ */
+void FrameAllocator::release(int frame)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (frame < 0 || frame >= _num_frames || !((_bitmap[frame / 64] >> (frame % 64)) & 1ULL))
+    {
+        return;
+    }
+
+    uint32_t word = frame / 64;
+    _bitmap[word] &= ~(1ULL << (frame % 64));
+    _num_free++;
+    if (word < _hint)
+    {
+        _hint = word;
+    }
+}
+
+/** Checks whether a frame is currently in use
+ * @param frame Frame number to check.
+ * @return True if the frame is allocated. False otherwise.
+ */
+bool FrameAllocator::isAllocated(int frame)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (frame < 0 || frame >= _num_frames)
+    {
+        return false;
+    }
+    return (_bitmap[frame / 64] >> (frame % 64)) & 1ULL;
+}
+
+/** Gets the total number of physical frames
+ * @return Number of frames managed by the allocator.
+ */
+uint32_t FrameAllocator::getNumFrames()
+{
+    return _num_frames;
+}
+
+/** Gets the number of frames that are not in use
+ * @return Number of free frames.
+ */
+uint32_t FrameAllocator::getNumFree()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _num_free;
+}
+
+/** Marks a particular frame as in use
+ * @param frame Frame number to take.
+ * @return True if the frame was free. False if it is out of range or already in use.
+ */
+bool FrameAllocator::reserve(int frame)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (frame < 0 || frame >= _num_frames || ((_bitmap[frame / 64] >> (frame % 64)) & 1ULL))
+    {
+        return false;
+    }
+    _bitmap[frame / 64] |= 1ULL << (frame % 64);
+    _num_free--;
+    return true;
+}
+
+/** Lists the frames in use
+ * @return Frame numbers of every allocated frame, in ascending order.
+ */
+std::vector<int> FrameAllocator::getAllocated()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    std::vector<int> frames;
+    frames.reserve(_num_frames - _num_free);
+    for (uint32_t word = 0; word < _bitmap.size(); word++)
+    {
+        uint64_t bits = _bitmap[word];
+        while (bits != 0)
+        {
+            int frame = word * 64 + __builtin_ctzll(bits);
+            if (frame >= _num_frames)
+            {
+                break;
+            }
+            frames.push_back(frame);
+            bits &= bits - 1;
+        }
+    }
+    return frames;
+}
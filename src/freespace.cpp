@@ -0,0 +1,419 @@
+#include "freespace.h"
+
+FreeSpaceIndex::FreeSpaceIndex()
+{
+    _rover = 0;
+    _free_bytes = 0;
+    _probes = 0;
+}
+
+FreeSpaceIndex::~FreeSpaceIndex()
+{
+}
+
+/** Adds a free extent to the index
+ * @param address Start address of the extent.
+ * @param size Size of the extent in bytes. Empty extents are ignored.
+ */
+void FreeSpaceIndex::insert(uint32_t address, uint32_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    _by_address[address] = size;
+    _by_size.insert(std::make_pair(size, address));
+    _bins[getBin(size)].insert(address);
+    _free_bytes += size;
+}
+
+/** Removes the free extent starting at an address from the index
+ * @param address Start address of the extent.
+ */
+void FreeSpaceIndex::erase(uint32_t address)
+{
+    std::map<uint32_t, uint32_t>::iterator it = _by_address.find(address);
+    if (it == _by_address.end())
+    {
+        return;
+    }
+    _by_size.erase(std::make_pair(it->second, address));
+    _bins[getBin(it->second)].erase(address);
+    _free_bytes -= it->second;
+    _by_address.erase(it);
+}
+
+/** Carves a block out of the free extent that contains it, keeping whatever is left on either side free
+ * @param address Start address of the block.
+ * @param size Size of the block in bytes.
+ * @return True if the block was entirely inside one free extent. False otherwise.
+ */
+bool FreeSpaceIndex::reserve(uint32_t address, uint32_t size)
+{
+    // The containing extent is the last one starting at or before the address
+    std::map<uint32_t, uint32_t>::iterator it = _by_address.upper_bound(address);
+    if (it == _by_address.begin())
+    {
+        return false;
+    }
+    it--;
+
+    uint32_t extent_address = it->first;
+    uint32_t extent_size = it->second;
+    if ((uint64_t)address + size > (uint64_t)extent_address + extent_size)
+    {
+        return false;
+    }
+
+    uint32_t left_slice = address - extent_address;
+    uint32_t right_slice = extent_size - (left_slice + size);
+    erase(extent_address);
+    insert(extent_address, left_slice);
+    insert(address + size, right_slice);
+    return true;
+}
+
+/** Returns a block to free space, merging it with the free extents directly before and after it
+ * @param address Start address of the block.
+ * @param size Size of the block in bytes.
+ */
+void FreeSpaceIndex::release(uint32_t address, uint32_t size)
+{
+    uint32_t start = address;
+    uint32_t end = address + size;
+
+    // Merge with the free extent directly after the block
+    std::map<uint32_t, uint32_t>::iterator next = _by_address.find(end);
+    if (next != _by_address.end())
+    {
+        end += next->second;
+        erase(next->first);
+    }
+
+    // Merge with the free extent directly before the block
+    std::map<uint32_t, uint32_t>::iterator prev = _by_address.lower_bound(start);
+    if (prev != _by_address.begin())
+    {
+        prev--;
+        if (prev->first + prev->second == start)
+        {
+            start = prev->first;
+            erase(prev->first);
+        }
+    }
+
+    insert(start, end - start);
+}
+
+/** Finds where to place a block according to a placement policy
+ * @param policy The placement policy.
+ * @param size Size of one element in bytes.
+ * @param page_size Size of one page.
+ * @param num_elements Number of elements in the block.
+ * @return Virtual address to place the block at. -1 if no extent can hold it.
+ */
+uint32_t FreeSpaceIndex::find(PlacementPolicy policy, int size, int page_size, int num_elements)
+{
+    STATS(_probes = 0);
+    switch (policy)
+    {
+        case FirstFit:
+            return findFirstFit(size, page_size, num_elements);
+        case NextFit:
+            return findNextFit(size, page_size, num_elements);
+        case WorstFit:
+            return findWorstFit(size, page_size, num_elements);
+        default:
+            return findBestFit(size, page_size, num_elements);
+    }
+}
+
+/** Finds the lowest addressed free extent that can hold the block
+ * @param size Size of one element in bytes.
+ * @param page_size Size of one page.
+ * @param num_elements Number of elements in the block.
+ * @return Virtual address to place the block at. -1 if no extent can hold it.
+ */
+uint32_t FreeSpaceIndex::findFirstFit(int size, int page_size, int num_elements)
+{
+    return findFromAddress(0, size, page_size, num_elements);
+}
+
+/** Finds the first free extent that can hold the block, starting where the previous next-fit search left off and
+ *  wrapping around to the lowest address
+ * @param size Size of one element in bytes.
+ * @param page_size Size of one page.
+ * @param num_elements Number of elements in the block.
+ * @return Virtual address to place the block at. -1 if no extent can hold it.
+ */
+uint32_t FreeSpaceIndex::findNextFit(int size, int page_size, int num_elements)
+{
+    uint32_t placement = findFromAddress(_rover, size, page_size, num_elements);
+    if (placement == (uint32_t)-1 && _rover != 0)
+    {
+        placement = findFromAddress(0, size, page_size, num_elements);
+    }
+    if (placement != (uint32_t)-1)
+    {
+        _rover = placement + size * num_elements;
+    }
+    return placement;
+}
+
+/** Finds the smallest free extent that can hold the block
+ * @param size Size of one element in bytes.
+ * @param page_size Size of one page.
+ * @param num_elements Number of elements in the block.
+ * @return Virtual address to place the block at. -1 if no extent can hold it.
+ */
+uint32_t FreeSpaceIndex::findBestFit(int size, int page_size, int num_elements)
+{
+    uint32_t array_size = size * num_elements;
+    uint32_t placement;
+
+    // Extents smaller than the block can never fit; larger ones only fail on alignment padding
+    std::set<std::pair<uint32_t, uint32_t> >::iterator it = _by_size.lower_bound(std::make_pair(array_size, 0));
+    for (; it != _by_size.end(); it++)
+    {
+        STATS(_probes++);
+        if (fitInExtent(it->second, it->first, size, page_size, num_elements, &placement))
+        {
+            return placement;
+        }
+    }
+    return -1;
+}
+
+/** Finds the largest free extent that can hold the block
+ * @param size Size of one element in bytes.
+ * @param page_size Size of one page.
+ * @param num_elements Number of elements in the block.
+ * @return Virtual address to place the block at. -1 if no extent can hold it.
+ */
+uint32_t FreeSpaceIndex::findWorstFit(int size, int page_size, int num_elements)
+{
+    uint32_t array_size = size * num_elements;
+    uint32_t placement;
+
+    // Only alignment padding can make the largest extent fail, so this rarely looks past the first one
+    std::set<std::pair<uint32_t, uint32_t> >::reverse_iterator it = _by_size.rbegin();
+    for (; it != _by_size.rend() && it->first >= array_size; it++)
+    {
+        STATS(_probes++);
+        if (fitInExtent(it->second, it->first, size, page_size, num_elements, &placement))
+        {
+            return placement;
+        }
+    }
+    return -1;
+}
+
+/** Gets the number of free extents
+ * @return Number of extents in the index.
+ */
+size_t FreeSpaceIndex::count()
+{
+    return _by_address.size();
+}
+
+/** Gets the total size of the free extents
+ * @return Number of free bytes.
+ */
+uint64_t FreeSpaceIndex::getFreeBytes()
+{
+    return _free_bytes;
+}
+
+/** Gets the number of extents the last find examined
+ * @return Number of extents, always 0 if built with MEMSIM_NO_STATS.
+ */
+uint32_t FreeSpaceIndex::getLastProbes()
+{
+    return _probes;
+}
+
+/** Gets the size of the largest free extent
+ * @return Size of the largest extent in bytes, 0 if there is none.
+ */
+uint32_t FreeSpaceIndex::getLargest()
+{
+    return _by_size.empty() ? 0 : _by_size.rbegin()->first;
+}
+
+/** Parses the name of a placement policy
+ * @param name "first", "next", "best" or "worst".
+ * @param policy Set to the policy.
+ * @return True if the name is a policy. False otherwise.
+ */
+bool FreeSpaceIndex::parsePolicy(const std::string& name, PlacementPolicy *policy)
+{
+    static const PlacementPolicy policies[] = {FirstFit, NextFit, BestFit, WorstFit};
+    for (int i = 0; i < 4; i++)
+    {
+        if (name == getPolicyName(policies[i]))
+        {
+            *policy = policies[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Gets the name of a placement policy
+ * @param policy The policy.
+ * @return The policy's name, as accepted by parsePolicy.
+ */
+const char* FreeSpaceIndex::getPolicyName(PlacementPolicy policy)
+{
+    switch (policy)
+    {
+        case FirstFit:
+            return "first";
+        case NextFit:
+            return "next";
+        case WorstFit:
+            return "worst";
+        default:
+            return "best";
+    }
+}
+
+/** Checks whether a block fits in a free extent. A block that crosses a page boundary is shifted forward so
+ *  that no element straddles the boundary.
+ * @param address Start address of the free extent.
+ * @param extent_size Size of the free extent.
+ * @param size Size of one element in bytes.
+ * @param page_size Size of one page.
+ * @param num_elements Number of elements in the block.
+ * @param placement Set to the address to place the block at if it fits.
+ * @return True if the block fits in the extent. False otherwise.
+ */
+bool FreeSpaceIndex::fitInExtent(uint32_t address, uint32_t extent_size, int size, int page_size, int num_elements, uint32_t *placement)
+{
+    uint64_t array_size = (uint64_t)size * num_elements;
+    uint32_t space_left_in_page = page_size - (address % page_size);
+    uint32_t byte_overrun = 0;
+
+    // If the block crosses into the next page, skip the bytes that would split an element across the boundary
+    if (array_size > space_left_in_page)
+    {
+        byte_overrun = space_left_in_page % size;
+    }
+
+    if (byte_overrun + array_size > extent_size)
+    {
+        return false;
+    }
+    *placement = address + byte_overrun;
+    return true;
+}
+
+/** Gets the size bin of an extent
+ * @param size Size of the extent, at least 1.
+ * @return Index of the highest set bit of the size.
+ */
+int FreeSpaceIndex::getBin(uint32_t size)
+{
+    return 31 - __builtin_clz(size);
+}
+
+/** Finds the lowest addressed free extent at or after an address that can hold the block. Every extent in a bin
+ *  above the block's own bin is larger than the block, so those bins only need their first extent past the start
+ *  checked; only the block's own bin is scanned.
+ * @param start Lowest extent start address to consider.
+ * @param size Size of one element in bytes.
+ * @param page_size Size of one page.
+ * @param num_elements Number of elements in the block.
+ * @return Virtual address to place the block at. -1 if no extent can hold it.
+ */
+uint32_t FreeSpaceIndex::findFromAddress(uint32_t start, int size, int page_size, int num_elements)
+{
+    uint32_t array_size = size * num_elements;
+    uint32_t best_address = -1;
+    uint32_t best_placement = -1;
+    uint32_t placement;
+
+    for (int bin = getBin(array_size == 0 ? 1 : array_size); bin < FREE_SPACE_BINS; bin++)
+    {
+        // Extents in a bin are ordered by address, stop at the first that fits or once past the best found so far
+        std::set<uint32_t>::iterator it = _bins[bin].lower_bound(start);
+        for (; it != _bins[bin].end() && (best_address == (uint32_t)-1 || *it < best_address); it++)
+        {
+            STATS(_probes++);
+            if (fitInExtent(*it, _by_address[*it], size, page_size, num_elements, &placement))
+            {
+                best_address = *it;
+                best_placement = placement;
+                break;
+            }
+        }
+    }
+    return best_placement;
+}
+
+/** Checks whether a block shares any byte with a free extent
+ * @param address Start address of the block.
+ * @param size Size of the block in bytes. An empty block overlaps nothing.
+ * @return True if part of the block is free. False otherwise.
+ */
+bool FreeSpaceIndex::overlaps(uint32_t address, uint32_t size)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+    std::map<uint32_t, uint32_t>::iterator it = _by_address.lower_bound(address);
+    if (it != _by_address.end() && it->first < (uint64_t)address + size)
+    {
+        return true;
+    }
+    if (it == _by_address.begin())
+    {
+        return false;
+    }
+    it--;
+    return (uint64_t)it->first + it->second > address;
+}
+
+/** Writes the free extents and the next-fit rover to a snapshot
+ * @param writer Snapshot being written.
+ */
+void FreeSpaceIndex::save(SnapshotWriter& writer)
+{
+    writer.put<uint32_t>(_by_address.size());
+    std::map<uint32_t, uint32_t>::iterator it;
+    for (it = _by_address.begin(); it != _by_address.end(); it++)
+    {
+        writer.put<uint32_t>(it->first);
+        writer.put<uint32_t>(it->second);
+    }
+    writer.put<uint32_t>(_rover);
+}
+
+/** Reads the free extents and the next-fit rover written by save into an empty index
+ * @param reader Snapshot being read.
+ * @param limit Size of the region the extents were carved from, starting at address 0.
+ * @return True if the extents were read. False if the snapshot is truncated, or holds an empty extent, one past the
+ *  limit or two that overlap.
+ */
+bool FreeSpaceIndex::load(SnapshotReader& reader, uint32_t limit)
+{
+    uint32_t count = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < count && reader.ok(); i++)
+    {
+        uint32_t address = reader.get<uint32_t>();
+        uint32_t size = reader.get<uint32_t>();
+        if (size == 0 || (uint64_t)address + size > limit || overlaps(address, size))
+        {
+            reader.fail();
+            break;
+        }
+        insert(address, size);
+    }
+    _rover = reader.get<uint32_t>();
+    if (_rover > limit)
+    {
+        reader.fail();
+    }
+    return reader.ok();
+}
@@ -1,22 +1,37 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <chrono>
 #include "mmu.h"
+#include "physicalmemory.h"
 #include "pagetable.h"
+#include "simulator.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "stats.h"
+#include "scriptreader.h"
+#include "tokenizer.h"
 
 void printStartMessage(int page_size);
-void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table);
-int allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table);
-void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory);
-void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table);
-void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table);
 
 // CUSTOM FUNCTIONS
-void printCommand(std::string object, Mmu *mmu, PageTable *page_table, void *memory);
-void launchSetVariable(uint32_t pid, std::string var_name, uint32_t offset, Mmu *mmu, PageTable *page_table, void *memory, Variable* variable, std::vector<std::string> command_list);
-int getDataTypeSize(DataType type);
-DataType stringToDataType(std::string input);
-void splitString(std::string text, char d, std::vector<std::string>& result);
+void runCommand(const std::vector<Token>& command_list, Mmu *mmu, PageTable *page_table, PhysicalMemory *physical_memory, TraceWriter *trace, CommandStats *stats);
+void printCommand(std::string object, Mmu *mmu, PageTable *page_table, void *memory, CommandStats *stats);
+uint64_t replayTrace(TraceReader& trace, Mmu *mmu, PageTable *page_table, PhysicalMemory *physical_memory, bool timing, CommandStats *stats);
+void replayOp(TraceOp op, TraceReader& trace, Mmu *mmu, PageTable *page_table, PhysicalMemory *physical_memory, CommandStats *stats);
+void finishCommand(int command, std::chrono::steady_clock::time_point start, CommandStats *stats, Mmu *mmu, PageTable *page_table);
+bool writeStatsFile(const std::string& path, CommandStats *stats, Mmu *mmu, PageTable *page_table);
+bool parseMemorySize(const char *text, uint64_t *size);
+bool parseOptionValue(const char *text, uint32_t *value);
+Variable* findVariable(const std::string& object, Mmu *mmu, uint32_t *pid, Process **process);
+void printCompaction(uint32_t pid, const CompactionResult& result);
+void launchSetVariable(uint32_t pid, std::string var_name, uint32_t offset, PageTable *page_table, void *memory, Variable* variable, const std::vector<Token>& command_list, TraceWriter *trace);
+void launchFreeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, void *memory);
+void launchCompact(const std::vector<uint32_t>& pids, Mmu *mmu, PageTable *page_table, void *memory);
+void launchDump(const std::string& object, const std::string& path, bool text, Mmu *mmu, PageTable *page_table, void *memory);
 
 int main(int argc, char **argv)
 {
@@ -27,80 +42,329 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // Print opening instuction message
+    // Parse optional settings
     int page_size = std::stoi(argv[1]);
-    printStartMessage(page_size);
+    uint32_t tlb_entries = 0;
+    uint32_t tlb_ways = 4;
+    TlbReplacement tlb_replacement = TlbLru;
+    bool tlb_tag_pids = true;
+    std::string script_path;
+    uint32_t num_frames = 0;
+    std::string swap_path;
+    std::string paging_policy = "lru";
+    uint64_t mem_size = 67108864; // 64 MB (64 * 1024 * 1024)
+    std::string memory_path;
+    PlacementPolicy placement = BestFit;
+    HeapBackend heap = FreeListHeap;
+    bool slab = false;
+    int compact_threshold = 0;
+    std::string record_path;
+    std::string replay_path;
+    bool timing = false;
+    std::string stats_path;
+    uint64_t stats_interval = 1000;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option == "--tlb-flush")
+        {
+            tlb_tag_pids = false;
+        }
+        else if (i + 1 < argc && option == "--tlb")
+        {
+            if (!parseOptionValue(argv[++i], &tlb_entries))
+            {
+                fprintf(stderr, "Error: invalid number of TLB entries '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (i + 1 < argc && option == "--tlb-ways")
+        {
+            if (!parseOptionValue(argv[++i], &tlb_ways))
+            {
+                fprintf(stderr, "Error: invalid number of TLB ways '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (i + 1 < argc && option == "--script")
+        {
+            script_path = argv[++i];
+        }
+        else if (i + 1 < argc && option == "--memory")
+        {
+            if (!parseMemorySize(argv[++i], &mem_size) || mem_size < (uint64_t)page_size)
+            {
+                fprintf(stderr, "Error: invalid memory size '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (i + 1 < argc && option == "--memory-file")
+        {
+            memory_path = argv[++i];
+        }
+        else if (i + 1 < argc && option == "--placement")
+        {
+            if (!FreeSpaceIndex::parsePolicy(argv[++i], &placement))
+            {
+                fprintf(stderr, "Error: unknown placement policy '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (i + 1 < argc && option == "--heap")
+        {
+            std::string backend = argv[++i];
+            if (backend != "freelist" && backend != "buddy")
+            {
+                fprintf(stderr, "Error: unknown heap '%s'\n", argv[i]);
+                return 1;
+            }
+            heap = (backend == "buddy") ? BuddyHeap : FreeListHeap;
+        }
+        else if (option == "--slab")
+        {
+            slab = true;
+        }
+        else if (i + 1 < argc && option == "--compact-threshold")
+        {
+            uint32_t percent;
+            if (!parseOptionValue(argv[++i], &percent) || percent > 100)
+            {
+                fprintf(stderr, "Error: compaction threshold must be a percentage\n");
+                return 1;
+            }
+            compact_threshold = percent;
+        }
+        else if (i + 1 < argc && option == "--record")
+        {
+            record_path = argv[++i];
+        }
+        else if (i + 1 < argc && option == "--replay")
+        {
+            replay_path = argv[++i];
+        }
+        else if (option == "--timing")
+        {
+            timing = true;
+        }
+        else if (i + 1 < argc && option == "--stats-file")
+        {
+            stats_path = argv[++i];
+        }
+        else if (i + 1 < argc && option == "--stats-interval")
+        {
+            uint32_t interval;
+            if (!parseOptionValue(argv[++i], &interval) || interval == 0)
+            {
+                fprintf(stderr, "Error: statistics interval must be at least 1 command\n");
+                return 1;
+            }
+            stats_interval = interval;
+        }
+        else if (i + 1 < argc && option == "--frames")
+        {
+            if (!parseOptionValue(argv[++i], &num_frames))
+            {
+                fprintf(stderr, "Error: invalid number of frames '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (i + 1 < argc && option == "--swap")
+        {
+            swap_path = argv[++i];
+        }
+        else if (i + 1 < argc && option == "--policy")
+        {
+            paging_policy = argv[++i];
+        }
+        else if (i + 1 < argc && option == "--tlb-policy")
+        {
+            std::string policy = argv[++i];
+            if (policy != "lru" && policy != "random")
+            {
+                fprintf(stderr, "Error: unknown TLB policy '%s'\n", argv[i]);
+                return 1;
+            }
+            tlb_replacement = (policy == "random") ? TlbRandom : TlbLru;
+        }
+        else
+        {
+            fprintf(stderr, "Error: unrecognized option '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // Each TLB set holds tlb_ways entries (0 ways makes one fully associative set), so there must be at least one
+    // whole set and a count that does not split into whole sets would lose entries
+    if (tlb_entries > 0 && tlb_ways > tlb_entries)
+    {
+        fprintf(stderr, "Error: TLB ways (%u) must not exceed the TLB entries (%u)\n", tlb_ways, tlb_entries);
+        return 1;
+    }
+    if (tlb_entries > 0 && tlb_ways > 0 && tlb_entries % tlb_ways != 0)
+    {
+        fprintf(stderr, "Error: TLB entries (%u) must be a multiple of the TLB ways (%u)\n", tlb_entries, tlb_ways);
+        return 1;
+    }
+
+    // Open the command file for batch mode
+    ScriptReader script;
+    bool batch_mode = !script_path.empty();
+    if (batch_mode && !script.open(script_path))
+    {
+        fprintf(stderr, "Error: could not open script '%s'\n", script_path.c_str());
+        return 1;
+    }
+
+    // A trace is replayed instead of reading commands, and is recorded from commands that are read
+    TraceReader replay;
+    TraceWriter record;
+    uint32_t trace_page_size;
+    if (!replay_path.empty() && (batch_mode || !record_path.empty()))
+    {
+        fprintf(stderr, "Error: --replay cannot be combined with --script or --record\n");
+        return 1;
+    }
+    if (!replay_path.empty() && !replay.open(replay_path, &trace_page_size))
+    {
+        fprintf(stderr, "Error: '%s' is not a version %d trace\n", replay_path.c_str(), TRACE_VERSION);
+        return 1;
+    }
+    if (!replay_path.empty() && trace_page_size != (uint32_t)page_size)
+    {
+        fprintf(stderr, "Error: trace was recorded with a page size of %u\n", trace_page_size);
+        return 1;
+    }
+    if (!record_path.empty() && !record.open(record_path, page_size))
+    {
+        fprintf(stderr, "Error: could not create trace '%s'\n", record_path.c_str());
+        return 1;
+    }
+    TraceWriter *trace = record_path.empty() ? NULL : &record;
+    batch_mode = batch_mode || !replay_path.empty();
+
+    // Create physical 'memory', committed by the host only as frames are touched
+    PhysicalMemory physical_memory;
+    if (!physical_memory.map(mem_size, memory_path))
+    {
+        fprintf(stderr, "Error: could not map %llu bytes of physical memory\n", (unsigned long long)mem_size);
+        return 1;
+    }
+    void *memory = physical_memory.getData();
+
+    // Print opening instuction message (batch mode has no user to instruct, and buffers all output)
+    if (batch_mode)
+    {
+        setvbuf(stdout, NULL, _IOFBF, SCRIPT_READER_BUFFER_SIZE);
+    }
+    else
+    {
+        printStartMessage(page_size);
+    }
 
-    // Create physical 'memory'
-    uint32_t mem_size = 67108864;
-    void *memory = malloc(mem_size); // 64 MB (64 * 1024 * 1024)
+    // Create MMU and Page Table. Virtual addresses are 32 bits, so each process' address space is capped at 4 GB
+    // (less one page) however large physical memory is, and frame numbers must fit in an int.
+    uint64_t max_virtual_size = 0x100000000ULL - page_size;
+    Mmu *mmu = new Mmu((uint32_t)std::min(mem_size, max_virtual_size));
+    mmu->setPlacementPolicy(placement);
+    mmu->setHeapBackend(heap);
+    mmu->setSlabEnabled(slab);
+    mmu->setCompactThreshold(compact_threshold);
+    uint64_t max_frames = std::min(mem_size / page_size, (uint64_t)INT32_MAX);
+    if (num_frames == 0 || num_frames > max_frames)
+    {
+        num_frames = (uint32_t)max_frames;
+    }
+    PageTable *page_table = new PageTable(page_size, num_frames);
+    page_table->setMemory(memory);
+    if (tlb_entries > 0)
+    {
+        page_table->enableTlb(tlb_entries, tlb_ways, tlb_replacement, tlb_tag_pids);
+    }
+    if (!swap_path.empty() && !page_table->enableDemandPaging(memory, paging_policy, swap_path))
+    {
+        fprintf(stderr, "Error: could not enable demand paging with policy '%s' and swap file '%s'\n",
+                paging_policy.c_str(), swap_path.c_str());
+        delete mmu;
+        delete page_table;
+        return 1;
+    }
 
-    // Create MMU and Page Table
-    Mmu *mmu = new Mmu(mem_size);
-    PageTable *page_table = new PageTable(page_size);
+    // Statistics are printed on request, and written to a file every so many commands if asked for
+    CommandStats command_stats;
+    command_stats.setOutput(stats_path, stats_interval);
 
-    // Prompt loop
-    std::vector<std::string> command_list;
+    std::vector<Token> command_list;
     std::string user_input;
-    std::cout << "> ";
-    std::getline (std::cin, user_input);
-    while (user_input != "exit") {
-        //Split full command line into command and arguments and store in command_list
-        splitString(user_input, ' ', command_list);
-        std::string command = command_list[0];
-
-        if(command == "create") {
-            createProcess(std::stoi(command_list[1]), std::stoi(command_list[2]), mmu, page_table);
-        } else if(command == "allocate" || command == "set" || command == "free") {
-            uint32_t pid = std::stoul(command_list[1]);
-            std::string var_name = command_list[2];
-            Process* process = mmu->getProcessByPID(pid);
-
-            // If the command is allocate, set, or free then try to find the PID and variable. Then print the proper error 
-            // based on if these are found or not. Otherwise, run the function.
-            if(process != NULL) {
-                Variable* variable = mmu->getVariableByProcessAndName(process, var_name);
-                if(variable != NULL) {
-                    if(command == "set") {
-                        launchSetVariable(pid, var_name, std::stoul(command_list[3]), mmu, page_table, memory, variable, command_list);
-                    } else if(command == "free") {
-                        freeVariable(pid, var_name, mmu, page_table);
-                    } else {
-                        printf("error: variable already exists\n");
-                    }
-                } else {
-                    if(command == "allocate") {
-                        int virtual_addr = allocateVariable(pid, var_name, stringToDataType(command_list[3]), std::stoul(command_list[4]), mmu, page_table);
-                        if(virtual_addr > -1) {
-                            printf("%d\n", virtual_addr);
-                        }
-                    } else {
-                        printf("error: variable not found\n");
-                    }
-                }
-            } else {
-                printf("error: process not found\n");
-            }
-        } else if(command == "terminate") {
-            uint32_t pid = std::stoul(command_list[1]);
-            if(mmu->getProcessByPID(pid) != NULL) {
-                terminateProcess(pid, mmu, page_table);
-            } else {
-                printf("error: process not found\n");
+    std::chrono::steady_clock::time_point command_start;
+    if (!replay_path.empty())
+    {
+        // Replay loop: commands are decoded straight from the trace
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint64_t num_commands = replayTrace(replay, mmu, page_table, &physical_memory, timing, &command_stats);
+        fflush(stdout);
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%llu commands in %.3f s (%.0f commands/sec)\n", (unsigned long long)num_commands, seconds,
+                seconds > 0 ? num_commands / seconds : 0.0);
+        if (!replay.ok())
+        {
+            fprintf(stderr, "Error: trace '%s' is truncated or corrupt\n", replay_path.c_str());
+        }
+    }
+    else if (batch_mode)
+    {
+        // Batch loop: no prompts, run until the end of the file or an exit command
+        uint64_t num_commands = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while (script.nextLine(user_input) && user_input != "exit")
+        {
+            tokenize(user_input, ' ', command_list);
+            if (!command_list.empty())
+            {
+                STATS(command_start = std::chrono::steady_clock::now());
+                runCommand(command_list, mmu, page_table, &physical_memory, trace, &command_stats);
+                finishCommand(CommandStats::getCommand(command_list[0].data, command_list[0].length), command_start,
+                              &command_stats, mmu, page_table);
+                num_commands++;
             }
-        } else if(command == "print") {
-            printCommand(command_list[1], mmu, page_table, memory);
-        } else {
-            printf("error: command not recognized\n");
         }
+        fflush(stdout);
 
-        // Get next command
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%llu commands in %.3f s (%.0f commands/sec)\n", (unsigned long long)num_commands, seconds,
+                seconds > 0 ? num_commands / seconds : 0.0);
+    }
+    else
+    {
+        // Prompt loop
         std::cout << "> ";
         std::getline (std::cin, user_input);
+        while (user_input != "exit" && std::cin) {
+            //Split full command line into command and arguments and store in command_list
+            tokenize(user_input, ' ', command_list);
+            if (!command_list.empty())
+            {
+                STATS(command_start = std::chrono::steady_clock::now());
+                runCommand(command_list, mmu, page_table, &physical_memory, trace, &command_stats);
+                finishCommand(CommandStats::getCommand(command_list[0].data, command_list[0].length), command_start,
+                              &command_stats, mmu, page_table);
+            }
+
+            // Get next command
+            std::cout << "> ";
+            std::getline (std::cin, user_input);
+        }
     }
 
     // Clean up
-    free(memory);
+    if (trace != NULL && !record.close())
+    {
+        fprintf(stderr, "Error: could not write trace '%s'\n", record_path.c_str());
+    }
+    if (!stats_path.empty() && !writeStatsFile(stats_path, &command_stats, mmu, page_table))
+    {
+        fprintf(stderr, "Error: could not write statistics '%s'\n", stats_path.c_str());
+    }
     delete mmu;
     delete page_table;
 
@@ -116,358 +380,819 @@ void printStartMessage(int page_size)
     std::cout << "  * set <PID> <var_name> <offset> <value_0> <value_1> <value_2> ... <value_N> (set the value for a variable)" << std:: endl;
     std::cout << "  * free <PID> <var_name> (deallocate memory on the heap that is associated with <var_name>)" << std:: endl;
     std::cout << "  * terminate <PID> (kill the specified process)" << std:: endl;
+    std::cout << "  * fork <PID> (copy a process, its pages are shared until either process sets them)" << std:: endl;
+    std::cout << "  * shmcreate <name> <bytes>[K|M|G] (create a shared memory segment), shmdestroy <name> (remove it once detached)" << std:: endl;
+    std::cout << "  * shmattach <PID> <name> (map a segment as a char variable <name>), shmdetach <PID> <name> (unmap it)" << std:: endl;
+    std::cout << "  * dump <PID>:<var_name> <file> [binary|text] (write every element of a variable to a file)" << std:: endl;
+    std::cout << "  * compact [PID] (move variables together and free the pages and frames this releases)" << std:: endl;
+    std::cout << "  * save <file> (write every process, page and frame in use to a snapshot), load <file> (restore one)" << std:: endl;
     std::cout << "  * print <object> (prints data)" << std:: endl;
     std::cout << "    * If <object> is \"mmu\", print the MMU memory table" << std:: endl;
     std::cout << "    * if <object> is \"page\", print the page table" << std:: endl;
     std::cout << "    * if <object> is \"processes\", print a list of PIDs for processes that are still running" << std:: endl;
+    std::cout << "    * if <object> is \"tlb\", print the TLB hit/miss statistics (requires --tlb <entries>)" << std:: endl;
+    std::cout << "    * if <object> is \"shm\", print the shared memory segments and the processes attached to them" << std:: endl;
+    std::cout << "    * if <object> is \"fragmentation\", print internal and external fragmentation of each process" << std:: endl;
+    std::cout << "    * if <object> is \"paging\", print page fault and eviction counts (requires --swap <file>)" << std:: endl;
+    std::cout << "    * if <object> is \"stats\", print command latencies, free space search lengths, translations and frames in use" << std:: endl;
     std::cout << "    * if <object> is a \"<PID>:<var_name>\", print the value of the variable for that process" << std:: endl;
+    std::cout << "Run \"memsim <page_size> --script <file>\" to execute a command file without prompts." << std:: endl;
+    std::cout << "Run with \"--memory <bytes>[K|M|G]\" to size physical memory, and \"--memory-file <file>\" to keep it in a file." << std:: endl;
+    std::cout << "Run with \"--placement first|next|best|worst\" to choose where variables are placed (default best)." << std:: endl;
+    std::cout << "Run with \"--heap buddy\" to allocate variables from power-of-two buddy blocks instead of a free list." << std:: endl;
+    std::cout << "Run with \"--slab\" to allocate single char, short, int, float, long and double variables from per-size page slabs." << std:: endl;
+    std::cout << "Run with \"--compact-threshold <percent>\" to compact a process when a free leaves that much of its heap in holes." << std:: endl;
+    std::cout << "Run with \"--frames <n> --swap <file> [--policy fifo|lru|clock|second-chance]\" to page to a swap file." << std:: endl;
+    std::cout << "Run with \"--record <file>\" to log every command run to a binary trace, and \"--replay <file> [--timing]\" to run one." << std:: endl;
+    std::cout << "Run with \"--stats-file <file> [--stats-interval <commands>]\" to write the statistics as JSON every 1000 (or <commands>) commands." << std:: endl;
     std::cout << std::endl;
 }
 
-void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table)
-{
-    //   - create new process in the MMU
-    int pid = mmu->createProcess();
-    //   - allocate new variables for the <TEXT>, <GLOBALS>, and <STACK>
-    allocateVariable(pid, "<TEXT>", Char, text_size, mmu, page_table);
-    allocateVariable(pid, "<GLOBALS>", Char, data_size, mmu, page_table);
-    allocateVariable(pid, "<STACK>", Char, 65536, mmu, page_table);
-    //   - print pid
-    printf("%d\n", pid);
-}
-
-int allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table)
-{
-    // Initialize Data
-    int size = getDataTypeSize(type);
-    uint32_t virtual_addr = -1;
+// ---------------------------------------------------------------------------------------------------------------- //
+// ------------------------------------------------CUSTOM FUNCTIONS------------------------------------------------ //
+// ---------------------------------------------------------------------------------------------------------------- //
 
-    // Search the page table to see if there is a location your variable will fit w/o allocating a new page.
-    std::vector<std::string> process_pages = page_table->getAllPagesForPID(pid);
-    for(std::vector<std::string>::iterator iter = process_pages.begin(); iter != process_pages.end() && virtual_addr == -1; ++iter)
-    {
-        // For each page table entry for process, check mmu for free space in that page
-        int page = std::stoi(iter->substr(iter->find("|") + 1));
-        virtual_addr = mmu->getFreeSpaceInPage(pid, page, size, page_table->getPageSize(), num_elements);
-    }
+/** Runs a single command.
+ *  @param command_list The command followed by its arguments, as views into the command line.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ *  @param physical_memory Physical memory.
+ *  @param trace Trace to record the command in once it is parsed, or NULL.
+ *  @param stats Command statistics, for print stats.
+ */
+void runCommand(const std::vector<Token>& command_list, Mmu *mmu, PageTable *page_table, PhysicalMemory *physical_memory, TraceWriter *trace, CommandStats *stats) {
+    const Token& command = command_list[0];
+    void *memory = physical_memory->getData();
+    uint32_t pid, offset, num_elements;
 
-    // Free space in existing page not found.
-    if(virtual_addr == -1) 
-    {
-        // Run the process again for all free spaces, and get the page number to add entry
-        virtual_addr = mmu->getFreeSpaceAnywhere(pid, size, page_table->getPageSize(), num_elements);
-        //! if -1 returned, there is no free memory anywhere
-        if(virtual_addr == -1)
-        {
-            printf("error: allocation exceeds system memory.\n");
-            return -1;
+    if(command.equals("create")) {
+        uint32_t text_size, data_size;
+        if(command_list.size() < 3 || !parseUnsigned(command_list[1], &text_size) || !parseUnsigned(command_list[2], &data_size)) {
+            printf("error: invalid arguments\n");
+            return;
         }
-    }
-    
-    // Load page if memory area falls outside of loaded pages.
-    int page = virtual_addr >> page_table->getOffsetSize();
-    int end_page = virtual_addr + (size * num_elements) >> page_table->getOffsetSize();
-    for(int i = page; i <= end_page; i++)
-    {
-        if(!page_table->entryExists(pid, i))
-        {
-            page_table->addEntry(pid, i);
+        if(trace != NULL) {
+            trace->putOp(TraceCreate);
+            trace->putVarint(text_size);
+            trace->putVarint(data_size);
         }
-    }
-
-    // Insert Variable into MMU and update Free Space
-    mmu->addVariableToProcess(pid, var_name, type, size * num_elements, virtual_addr);
-    mmu->updateFreeSpace(pid, virtual_addr, size * num_elements);
-
-    // Print Virtual Memory Address
-    return virtual_addr;
-}
-
-void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory)
-{
-    //   * note: this function only handles a single element (i.e. you'll need to call this within a loop when setting multiple elements of an array)
-
-    // Get process and initialize variable data
-    Process* p = mmu->getProcessByPID(pid);
-    uint32_t virtual_address = -1;
-    DataType type;
-
-    // Get variable information from process
-    for(int vi = 0; vi < p->variables.size(); vi++)
-    {
-        Variable* v = p->variables[vi];
-        if(var_name == v->name)
-        {
-            virtual_address = v->virtual_address;
-            type = v->type;
+        printf("%u\n", createProcess(text_size, data_size, mmu, page_table));
+    } else if(command.equals("allocate") || command.equals("set") || command.equals("free")) {
+        if(command_list.size() < 3 || !parseUnsigned(command_list[1], &pid)) {
+            printf("error: invalid arguments\n");
+            return;
         }
-    }
-
-    // Get physical address from page table
-    uint32_t physical_address = page_table->getPhysicalAddress(pid, virtual_address + (offset * getDataTypeSize(type)));
+        std::string var_name = command_list[2].str();
+        Process* process = mmu->acquireProcess(pid);
 
-    // Copy value into memory with an offset of the physical address
-    memcpy(((char*)memory + physical_address), value, getDataTypeSize(type));
-}
-
-void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table)
-{
-    // Get vector of pages exclusively containing var_name
-    std::vector<int> exclusive_pages = mmu->getExclusivePages(pid, var_name, page_table->getPageSize());
-
-    // Remove entry from MMU
-    mmu->removeVariable(pid, var_name);
-
-    // Loop through the vector of exclusive pages and remove them from the page table
-    for(int i = 0; i < exclusive_pages.size(); i++) {
-        page_table->removeEntry(pid, exclusive_pages[i]);
+        // If the command is allocate, set, or free then try to find the PID and variable. Then print the proper error 
+        // based on if these are found or not. Otherwise, run the function. The process stays locked throughout.
+        if(process != NULL) {
+            Variable* variable = mmu->getVariableByProcessAndName(process, var_name);
+            if(variable != NULL) {
+                if(command.equals("set")) {
+                    if(command_list.size() < 4 || !parseUnsigned(command_list[3], &offset)) {
+                        printf("error: invalid arguments\n");
+                    } else {
+                        launchSetVariable(pid, var_name, offset, page_table, memory, variable, command_list, trace);
+                    }
+                } else if(command.equals("free")) {
+                    if(trace != NULL) {
+                        uint32_t name_id = trace->intern(var_name);
+                        trace->putOp(TraceFree);
+                        trace->putVarint(pid);
+                        trace->putVarint(name_id);
+                    }
+                    launchFreeVariable(pid, var_name, mmu, page_table, memory);
+                } else {
+                    printf("error: variable already exists\n");
+                }
+            } else {
+                if(command.equals("allocate")) {
+                    // An unknown type would make a variable with elements of no size
+                    DataType type = command_list.size() < 5 ? FreeSpace : stringToDataType(command_list[3].str());
+                    if(type == FreeSpace || !parseUnsigned(command_list[4], &num_elements)) {
+                        printf("error: invalid arguments\n");
+                    } else {
+                        if(trace != NULL) {
+                            uint32_t name_id = trace->intern(var_name);
+                            trace->putOp(TraceAllocate);
+                            trace->putVarint(pid);
+                            trace->putVarint(name_id);
+                            trace->putVarint(type);
+                            trace->putVarint(num_elements);
+                        }
+                        int virtual_addr = allocateVariable(pid, var_name, type, num_elements, mmu, page_table);
+                        if(virtual_addr > -1) {
+                            printf("%d\n", virtual_addr);
+                        }
+                    }
+                } else {
+                    printf("error: variable not found\n");
+                }
+            }
+            mmu->releaseProcess(process);
+        } else {
+            printf("error: process not found\n");
+        }
+    } else if(command.equals("terminate")) {
+        if(command_list.size() < 2 || !parseUnsigned(command_list[1], &pid)) {
+            printf("error: invalid arguments\n");
+            return;
+        }
+        if(mmu->getProcessByPID(pid) != NULL) {
+            if(trace != NULL) {
+                trace->putOp(TraceTerminate);
+                trace->putVarint(pid);
+            }
+            terminateProcess(pid, mmu, page_table);
+        } else {
+            printf("error: process not found\n");
+        }
+    } else if(command.equals("fork")) {
+        if(command_list.size() < 2 || !parseUnsigned(command_list[1], &pid)) {
+            printf("error: invalid arguments\n");
+            return;
+        }
+        if(mmu->getProcessByPID(pid) == NULL) {
+            printf("error: process not found\n");
+            return;
+        }
+        if(trace != NULL) {
+            trace->putOp(TraceFork);
+            trace->putVarint(pid);
+        }
+        uint32_t child_pid = forkProcess(pid, mmu, page_table);
+        if(child_pid == (uint32_t)-1) {
+            printf("error: could not copy swapped out pages\n");
+        } else {
+            printf("%u\n", child_pid);
+        }
+    } else if(command.equals("shmcreate") || command.equals("shmdestroy")) {
+        uint64_t size = 0;
+        if(command_list.size() < 2 || (command.equals("shmcreate") && (command_list.size() < 3 ||
+           !parseMemorySize(command_list[2].str().c_str(), &size) || size == 0 || size > UINT32_MAX))) {
+            printf("error: invalid arguments\n");
+            return;
+        }
+        std::string name = command_list[1].str();
+        if(command.equals("shmdestroy")) {
+            if(trace != NULL) {
+                uint32_t name_id = trace->intern(name);
+                trace->putOp(TraceShmDestroy);
+                trace->putVarint(name_id);
+            }
+            if(!page_table->destroySegment(name)) {
+                printf("error: segment not found\n");
+            }
+        } else if(page_table->getSegmentSize(name) != 0) {
+            printf("error: segment already exists\n");
+        } else {
+            if(trace != NULL) {
+                uint32_t name_id = trace->intern(name);
+                trace->putOp(TraceShmCreate);
+                trace->putVarint(name_id);
+                trace->putVarint(size);
+            }
+            if(!page_table->createSegment(name, size)) {
+                printf("error: allocation exceeds system memory.\n");
+            }
+        }
+    } else if(command.equals("shmattach") || command.equals("shmdetach")) {
+        if(command_list.size() < 3 || !parseUnsigned(command_list[1], &pid)) {
+            printf("error: invalid arguments\n");
+            return;
+        }
+        std::string name = command_list[2].str();
+        if(trace != NULL && (command.equals("shmattach") || mmu->getProcessByPID(pid) != NULL)) {
+            uint32_t name_id = trace->intern(name);
+            trace->putOp(command.equals("shmattach") ? TraceShmAttach : TraceShmDetach);
+            trace->putVarint(pid);
+            trace->putVarint(name_id);
+        }
+        if(command.equals("shmattach")) {
+            int virtual_addr = attachSegment(pid, name, mmu, page_table);
+            if(virtual_addr > -1) {
+                printf("%d\n", virtual_addr);
+            }
+        } else if(mmu->getProcessByPID(pid) == NULL) {
+            printf("error: process not found\n");
+        } else if(!detachSegment(pid, name, mmu, page_table)) {
+            printf("error: segment not attached\n");
+        }
+    } else if(command.equals("dump")) {
+        bool text = command_list.size() > 3 && command_list[3].equals("text");
+        if(command_list.size() < 3 || (command_list.size() > 3 && !text && !command_list[3].equals("binary"))) {
+            printf("error: invalid arguments\n");
+            return;
+        }
+        if(trace != NULL) {
+            uint32_t object_id = trace->intern(command_list[1].str());
+            uint32_t path_id = trace->intern(command_list[2].str());
+            trace->putOp(TraceDump);
+            trace->putVarint(object_id);
+            trace->putVarint(path_id);
+            trace->putVarint(text);
+        }
+        launchDump(command_list[1].str(), command_list[2].str(), text, mmu, page_table, memory);
+    } else if(command.equals("compact")) {
+        // Compact one process, or every process
+        std::vector<uint32_t> pids;
+        if(command_list.size() > 1) {
+            if(!parseUnsigned(command_list[1], &pid)) {
+                printf("error: invalid arguments\n");
+                return;
+            }
+            if(mmu->getProcessByPID(pid) == NULL) {
+                printf("error: process not found\n");
+                return;
+            }
+            pids.push_back(pid);
+        } else {
+            pids = mmu->getPIDs();
+        }
+        if(trace != NULL) {
+            trace->putOp(command_list.size() > 1 ? TraceCompact : TraceCompactAll);
+            if(command_list.size() > 1) {
+                trace->putVarint(pid);
+            }
+        }
+        launchCompact(pids, mmu, page_table, memory);
+    } else if(command.equals("save") || command.equals("load")) {
+        if(command_list.size() < 2) {
+            printf("error: invalid arguments\n");
+            return;
+        }
+        std::string path = command_list[1].str();
+        if(trace != NULL) {
+            uint32_t path_id = trace->intern(path);
+            trace->putOp(command.equals("load") ? TraceLoad : TraceSave);
+            trace->putVarint(path_id);
+        }
+        if(command.equals("load")) {
+            loadSnapshot(path, mmu, page_table, physical_memory);
+        } else if(!saveSnapshot(path, mmu, page_table, physical_memory)) {
+            printf("error: could not write \"%s\"\n", path.c_str());
+        }
+    } else if(command.equals("print")) {
+        if(command_list.size() < 2) {
+            printf("error: invalid arguments\n");
+            return;
+        }
+        if(trace != NULL) {
+            uint32_t object_id = trace->intern(command_list[1].str());
+            trace->putOp(TracePrint);
+            trace->putVarint(object_id);
+        }
+        printCommand(command_list[1].str(), mmu, page_table, memory, stats);
+    } else {
+        printf("error: command not recognized\n");
     }
 }
 
-void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table)
-{
-    // Remove Process from the MMU
-    mmu->removeProcess(pid);
-
-    // Remove all pages for the process from the page table
-    auto process_entries = page_table->getAllPagesForPID(pid);
-    for(int i = 0; i < process_entries.size(); i++)
-    {
-        std::string entry = process_entries[i];
-        page_table->removeEntry(entry);
-    }
+/** Prints what compacting a process did.
+ *  @param pid PID of the compacted process.
+ *  @param result What the compaction did.
+ */
+void printCompaction(uint32_t pid, const CompactionResult& result) {
+    printf("compacted %u: moved %u variables (%llu bytes), reclaimed %u pages, moved %u frames\n", pid,
+           result.variables_moved, (unsigned long long)result.bytes_moved, result.pages_reclaimed, result.frames_moved);
 }
 
-
-
-// ---------------------------------------------------------------------------------------------------------------- //
-// ------------------------------------------------CUSTOM FUNCTIONS------------------------------------------------ //
-// ---------------------------------------------------------------------------------------------------------------- //
-
 /** Handles the print command if entered by the user.
- *  @param object The object to print. Either "mmu", "page", "processes", or "[PID]:[variable Name]"
+ *  @param object The object to print. Either "mmu", "page", "processes", "tlb", "paging", "fragmentation", "shm", "stats", or "[PID]:[variable Name]"
  *  @param mmu Pointer to the mmu to print.
  *  @param page_table Pointer to the page table to print.
  *  @param memory Pointer to the memory to print the value of the given variable
+ *  @param stats Command statistics to print for "stats".
  */
-void printCommand(std::string object, Mmu *mmu, PageTable *page_table, void *memory) {
+void printCommand(std::string object, Mmu *mmu, PageTable *page_table, void *memory, CommandStats *stats) {
     if(object == "mmu") {
         mmu->print();
     } else if(object == "page") {
         page_table->print();
+    } else if(object == "tlb") {
+        if(page_table->getTlb() != NULL) {
+            page_table->getTlb()->print(page_table->getPageSize());
+        } else {
+            printf("error: TLB not enabled\n");
+        }
+    } else if(object == "shm") {
+        page_table->printSegments();
+    } else if(object == "fragmentation") {
+        mmu->printFragmentation();
+    } else if(object == "paging") {
+        page_table->printPagingStats();
+    } else if(object == "stats") {
+        if(!STATS_ENABLED) {
+            printf("Statistics: disabled (built with MEMSIM_NO_STATS)\n");
+            return;
+        }
+        stats->print();
+        mmu->printStats();
+        page_table->printStats();
     } else if(object == "processes") {
         // Prints the PIDs of all running processes
-        std::vector<Process*> processes = mmu->getProcessesVector();
-        for(int i=0; i<processes.size(); i++) {
-            std::cout << processes[i]->pid << std::endl;
+        std::vector<uint32_t> pids = mmu->getPIDs();
+        for(int i=0; i<pids.size(); i++) {
+            printf("%u\n", pids[i]);
         }
     } else {
-        size_t delim_pos = object.find(":");
-        uint32_t pid = std::stoul(object.substr(0, delim_pos));
-        std::string var_name = object.substr(delim_pos+1);
+        uint32_t pid;
+        Process* process;
+        Variable* var = findVariable(object, mmu, &pid, &process);
+        if(var == NULL) {
+            return;
+        }
 
-        Variable* var = mmu->getVariableByProcessAndName(mmu->getProcessByPID(pid), var_name);
-        int physical_address = page_table->getPhysicalAddress(pid, var->virtual_address);
+        // Only the first few elements are shown, read them in one go
         int data_size = getDataTypeSize(var->type);
         int num_elements = (int)(var->size / data_size);
-        for(int i = 0; i < num_elements; i++) {
+        int num_shown = std::min(num_elements, 4);
+        double values[4];
+        bool read = readVariableElements(pid, var, 0, values, num_shown, page_table, memory);
+        mmu->releaseProcess(process);
+        if(!read) {
+            printf("error: variable could not be read\n");
+            return;
+        }
+        for(int i = 0; i < num_shown; i++) {
             // if not the first element, print a comma
             if(i > 0) {
                 printf(", ");
             }
-        
-            if(i >= 4) // if ceiling hit, print etc and break out of the loop
-            {
-                printf("... [%d items]", num_elements);
-                break;
-            }
-            else // else, print the value as normal
-            {
-                void* value = malloc(data_size);
-                memcpy(value, (char*)memory + physical_address + (i * data_size), data_size);
-                switch(var->type) {
-                    case DataType::Char:
-                        printf("%c", *(char*)value);
-                        break;
-                    case DataType::Short:
-                        printf("%d", *(short*)value);
-                        break;
-                    case DataType::Long:
-                        printf("%ld", *(long*)value);
-                        break;
-                    case DataType::Int:
-                        printf("%d", *(int*)value);
-                        break;
-                    case DataType::Float:
-                        printf("%f", *(float*)value);
-                        break;
-                    case DataType::Double:
-                        printf("%lf", *(double*)value);
-                        break;
-                }
-                free(value);
-            }
+            printElement(stdout, var->type, (char*)values + (i * data_size));
+        }
+        if(num_elements > num_shown) // if ceiling hit, print etc
+        {
+            printf(", ... [%d items]", num_elements);
         }
         printf("\n");
     }
 }
 
-/** Launches setVariable() with the correct DataType.
+/** Launches setVariableElement() with the correct DataType. The variable is resolved once by the caller, and values
+ *  are parsed straight from the command line tokens. The values that parse are recorded in the trace, if there is one.
  */
-void launchSetVariable(uint32_t pid, std::string var_name, uint32_t offset, Mmu *mmu, PageTable *page_table, void *memory, Variable* variable, std::vector<std::string> command_list) {
+void launchSetVariable(uint32_t pid, std::string var_name, uint32_t offset, PageTable *page_table, void *memory, Variable* variable, const std::vector<Token>& command_list, TraceWriter *trace) {
     uint32_t var_type_size = getDataTypeSize(variable->type);   // Get the size of the type of variable
     DataType var_type = variable->type;                         // Get the type of the variable
-    void* value = malloc(var_type_size);                        // Allocate memory depending on the size of the variable being set
-    for(int i=4; i<command_list.size(); i++) {
-        int local_offset = i - 4;
-        // if offset goes beyond variable limits, break out of for loop
-        if(offset + local_offset >= (variable->size/var_type_size)) break;
+    uint32_t num_elements = variable->size / var_type_size;
 
+    // Parse every value into a staging buffer laid out like the variable, then copy it into memory in one pass. The
+    // buffer is local because worker threads set variables concurrently
+    std::vector<char> staging;
+    uint32_t num_values = 0;
+    if(offset < num_elements) {
+        num_values = std::min((uint32_t)command_list.size() - 4, num_elements - offset);
+    }
+    staging.resize((size_t)num_values * var_type_size);
+
+    uint32_t num_parsed = 0;
+    bool valid = true;
+    for(; num_parsed < num_values && valid; num_parsed++) {
         // Convert the user input to the correct data type based on the data type of the variable being set
+        const Token& token = command_list[4 + num_parsed];
+        char *slot = &staging[(size_t)num_parsed * var_type_size];
         switch(var_type) {
-            case DataType::Char: 
-                setVariable(pid, var_name, offset + local_offset, (void*)&command_list[i].c_str()[0], mmu, page_table, memory);
-                break;
-            case DataType::Int: {
-                    int value = std::stoi(command_list[i]);
-                    setVariable(pid, var_name, offset + local_offset, (void*)&value, mmu, page_table, memory);
-                }
+            case DataType::Char:
+                *slot = token.data[0];
                 break;
+            case DataType::Int:
             case DataType::Long:
-                {
-                    long value = std::stol(command_list[i]);
-                    setVariable(pid, var_name, offset + local_offset, (void*)&value, mmu, page_table, memory);
-                }
-                break;
             case DataType::Short:
                 {
-                    short value = (short)std::stoi(command_list[i]);
-                    setVariable(pid, var_name, offset + local_offset, (void*)&value, mmu, page_table, memory);
+                    // Values that do not fit the variable's type are rejected rather than truncated
+                    long parsed;
+                    valid = parseLong(token, &parsed);
+                    if(var_type == DataType::Int) {
+                        valid = valid && parsed >= INT_MIN && parsed <= INT_MAX;
+                    } else if(var_type == DataType::Short) {
+                        valid = valid && parsed >= SHRT_MIN && parsed <= SHRT_MAX;
+                    }
+                    int int_value = (int)parsed;
+                    short short_value = (short)parsed;
+                    void *value = (var_type == DataType::Long) ? (void*)&parsed : (var_type == DataType::Int) ? (void*)&int_value : (void*)&short_value;
+                    memcpy(slot, value, var_type_size);
                 }
                 break;
             case DataType::Float:
-                {
-                    float value = std::stof(command_list[i]);
-                    setVariable(pid, var_name, offset + local_offset, (void*)&value, mmu, page_table, memory);
-                }
+                valid = parseFloat(token, (float*)slot);
                 break;
             case DataType::Double:
-                {
-                    double value = std::stod(command_list[i]);
-                    setVariable(pid, var_name, offset + local_offset, (void*)&value, mmu, page_table, memory);
-                }
+                valid = parseDouble(token, (double*)slot);
                 break;
         }
     }
-    free(value);
+
+    // Values before an invalid one are still set
+    uint32_t num_valid = valid ? num_parsed : num_parsed - 1;
+    if(trace != NULL && num_valid > 0) {
+        uint32_t name_id = trace->intern(var_name);
+        trace->putOp(TraceSet);
+        trace->putVarint(pid);
+        trace->putVarint(name_id);
+        trace->putVarint(offset);
+        trace->putVarint(var_type);
+        trace->putVarint(num_valid);
+        trace->putBytes(staging.data(), (size_t)num_valid * var_type_size);
+    }
+    if(!setVariableElements(pid, variable, offset, staging.data(), num_valid, page_table, memory)) {
+        printf("error: allocation exceeds system memory.\n");
+    }
+    if(!valid) {
+        printf("error: invalid value \"%s\"\n", command_list[4 + num_valid].str().c_str());
+    }
 }
 
-/** Converts a DataType to an integer equal to its corresponding size.
- *  @param type The given DataType to get the size of.
- *  @return Returns the corresponding size for the given DataType. Will return 0 if given FreeSpace.
+/** Parses the value of a command line option as an unsigned 32 bit integer.
+ *  @param text The value.
+ *  @param value Set to the parsed number.
+ *  @return True if the whole value is a non-negative integer that fits. False otherwise.
  */
-int getDataTypeSize(DataType type) {
-    int size = 0; // in bytes
-    switch(type)
-    {
-        case Char:
-            size = 1;
-            break;
-        case Short:
-            size = 2;
-            break;
-        case Int:
-        case Float:
-            size = 4;
-            break;
-        case Long:
-        case Double:
-            size = 8;
-            break;
+bool parseOptionValue(const char *text, uint32_t *value) {
+    Token token = {text, strlen(text)};
+    return parseUnsigned(token, value);
+}
+
+/** Parses a memory size given in bytes, with an optional K, M or G suffix (powers of 1024).
+ *  @param text The size, e.g. "4096", "256M" or "8G".
+ *  @param size Set to the size in bytes.
+ *  @return True if the size is valid. False otherwise.
+ */
+bool parseMemorySize(const char *text, uint64_t *size) {
+    char *end;
+    if(*text < '0' || *text > '9') {
+        return false;
     }
-    return size;
+    uint64_t value = strtoull(text, &end, 10);
+    int shift = 0;
+    if(*end == 'K' || *end == 'k') {
+        shift = 10;
+    } else if(*end == 'M' || *end == 'm') {
+        shift = 20;
+    } else if(*end == 'G' || *end == 'g') {
+        shift = 30;
+    }
+    if(shift > 0) {
+        end++;
+    }
+    if(*end != '\0' || value == 0 || value > (UINT64_MAX >> shift)) {
+        return false;
+    }
+    *size = value << shift;
+    return true;
 }
 
-/** Converts a string to one of the DataType enumerators defined in mmu.cpp based on its string equivalent.
- *  @param input The user input string that is meant to be a DataType represented with text.
- *  @return Returns the associated DataType enum or FreeSpace if no DataType can be associated.
+/** Looks up the variable named by a "<PID>:<var_name>" argument, printing an error if there is none.
+ *  @param object The "<PID>:<var_name>" argument.
+ *  @param mmu Pointer to the mmu.
+ *  @param pid Set to the PID of the variable's process.
+ *  @param process Set to the variable's process, which is left locked for the caller to release.
+ *  @return Pointer to the variable, or NULL if the argument is malformed or the process or variable does not exist.
  */
-DataType stringToDataType(std::string input) {
-    if(input == "char") {
-        return DataType::Char;
-    } else if(input == "short") {
-        return DataType::Short;
-    } else if(input == "int") {
-        return DataType::Int;
-    } else if(input == "float") {
-        return DataType::Float;
-    } else if(input == "long") {
-        return DataType::Long;
-    } else if(input == "double") {
-        return DataType::Double;
-    } else {
-        //If freespace is returned, that means the string was unrecognized
-        return DataType::FreeSpace; 
+Variable* findVariable(const std::string& object, Mmu *mmu, uint32_t *pid, Process **process) {
+    size_t delim_pos = object.find(":");
+    Token pid_token = {object.data(), delim_pos == std::string::npos ? object.size() : delim_pos};
+    if(delim_pos == std::string::npos || !parseUnsigned(pid_token, pid)) {
+        printf("error: invalid arguments\n");
+        return NULL;
+    }
+
+    *process = mmu->acquireProcess(*pid);
+    if(*process == NULL) {
+        printf("error: process not found\n");
+        return NULL;
     }
+    Variable* var = mmu->getVariableByProcessAndName(*process, object.substr(delim_pos+1));
+    if(var == NULL) {
+        mmu->releaseProcess(*process);
+        printf("error: variable not found\n");
+    }
+    return var;
 }
 
-/* [splitSting() from Assignment 2 - osshell]
-   text: string to split
-   d: character delimiter to split `text` on
-   result: vector of strings - result will be stored here
-*/
-void splitString(std::string text, char d, std::vector<std::string>& result)
-{
-    enum states { NONE, IN_WORD, IN_STRING } state = NONE;
+/** Frees a variable, then compacts its process if enough of the heap is left in holes (see --compact-threshold).
+ *  @param pid PID of the variable's process.
+ *  @param var_name Name of the variable.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ *  @param memory Pointer to physical memory.
+ */
+void launchFreeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, void *memory) {
+    freeVariable(pid, var_name, mmu, page_table);
+    if(mmu->getCompactThreshold() > 0 && mmu->getHolePercent(pid) >= mmu->getCompactThreshold()) {
+        CompactionResult result;
+        compactProcess(pid, mmu, page_table, memory, &result);
+        printCompaction(pid, result);
+    }
+}
 
-    int i;
-    std::string token;
-    result.clear();
-    for (i = 0; i < text.length(); i++)
-    {
-        char c = text[i];
-        switch (state) {
-            case NONE:
-                if (c != d)
-                {
-                    if (c == '\"')
-                    {
-                        state = IN_STRING;
-                        token = "";
-                    }
-                    else
-                    {
-                        state = IN_WORD;
-                        token = c;
-                    }
+/** Compacts processes one after the other, printing what each compaction did.
+ *  @param pids PIDs of the processes.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ *  @param memory Pointer to physical memory.
+ */
+void launchCompact(const std::vector<uint32_t>& pids, Mmu *mmu, PageTable *page_table, void *memory) {
+    for(int i = 0; i < pids.size(); i++) {
+        CompactionResult result;
+        if(!compactProcess(pids[i], mmu, page_table, memory, &result) && mmu->getProcessByPID(pids[i]) != NULL) {
+            printf("error: allocation exceeds system memory.\n");
+        }
+        printCompaction(pids[i], result);
+    }
+}
+
+/** Writes every element of a variable to a file, printing an error if it cannot.
+ *  @param object The "<PID>:<var_name>" argument.
+ *  @param path File to write.
+ *  @param text True to write one element per line, false to write the raw bytes.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ *  @param memory Pointer to physical memory.
+ */
+void launchDump(const std::string& object, const std::string& path, bool text, Mmu *mmu, PageTable *page_table, void *memory) {
+    uint32_t pid;
+    Process* process;
+    Variable* var = findVariable(object, mmu, &pid, &process);
+    if(var == NULL) {
+        return;
+    }
+    if(!dumpVariable(pid, var, path, text, page_table, memory)) {
+        printf("error: could not write \"%s\"\n", path.c_str());
+    }
+    mmu->releaseProcess(process);
+}
+
+/** Runs every command of a trace recorded with --record, printing what the commands print.
+ *  @param trace The trace, opened past its header.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ *  @param physical_memory Physical memory.
+ *  @param timing True to time each command and print the times per command to stderr at the end.
+ *  @param stats Command statistics, which the replayed commands are counted in as if typed.
+ *  @return Number of commands run. The trace is left not ok if it is truncated or corrupt.
+ */
+uint64_t replayTrace(TraceReader& trace, Mmu *mmu, PageTable *page_table, PhysicalMemory *physical_memory, bool timing, CommandStats *stats) {
+    uint64_t num_commands = 0;
+    uint64_t counts[TRACE_OPS] = {0};
+    uint64_t total_ns[TRACE_OPS] = {0};
+    uint64_t max_ns[TRACE_OPS] = {0};
+    int commands[TRACE_OPS];
+    for(int i = 0; i < TRACE_OPS; i++) {
+        const char *name = (i == TraceCompactAll) ? "compact" : TraceReader::getOpName((TraceOp)i);
+        commands[i] = CommandStats::getCommand(name, strlen(name));
+    }
+
+    TraceOp op;
+    while(trace.nextOp(&op)) {
+        std::chrono::steady_clock::time_point start;
+        if(timing || STATS_ENABLED) {
+            start = std::chrono::steady_clock::now();
+        }
+        replayOp(op, trace, mmu, page_table, physical_memory, stats);
+        if(timing) {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            counts[op]++;
+            total_ns[op] += ns;
+            max_ns[op] = std::max(max_ns[op], ns);
+        }
+        finishCommand(commands[op], start, stats, mmu, page_table);
+        if(!trace.ok()) {
+            break;
+        }
+        num_commands++;
+    }
+
+    if(timing) {
+        fprintf(stderr, " Command     | Count      | Total ms   | Mean us    | Max us\n");
+        fprintf(stderr, "-------------+------------+------------+------------+------------\n");
+        for(int i = 0; i < TRACE_OPS; i++) {
+            if(counts[i] > 0) {
+                fprintf(stderr, " %-11s | %10llu | %10.3f | %10.3f | %10.3f\n", TraceReader::getOpName((TraceOp)i),
+                        (unsigned long long)counts[i], total_ns[i] / 1e6, total_ns[i] / 1e3 / counts[i], max_ns[i] / 1e3);
+            }
+        }
+    }
+    return num_commands;
+}
+
+/** Runs one command of a trace. Commands were recorded once their arguments were parsed, so only the errors that
+ *  depend on the simulator's state are printed again.
+ *  @param op The command.
+ *  @param trace The trace, positioned at the command's operands.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ *  @param physical_memory Physical memory.
+ *  @param stats Command statistics, for print stats.
+ */
+void replayOp(TraceOp op, TraceReader& trace, Mmu *mmu, PageTable *page_table, PhysicalMemory *physical_memory, CommandStats *stats) {
+    void *memory = physical_memory->getData();
+    uint32_t pid;
+
+    switch(op) {
+        case TraceCreate: {
+            uint32_t text_size = trace.getVarint();
+            uint32_t data_size = trace.getVarint();
+            if(trace.ok()) {
+                printf("%u\n", createProcess(text_size, data_size, mmu, page_table));
+            }
+            break;
+        }
+        case TraceAllocate:
+        case TraceSet:
+        case TraceFree: {
+            pid = trace.getVarint();
+            const std::string& var_name = trace.getName();
+            uint32_t offset = op == TraceSet ? trace.getVarint() : 0;
+            uint64_t type = op != TraceFree ? trace.getVarint() : Char;
+            uint32_t count = op != TraceFree ? trace.getVarint() : 0;
+            // Variables always have an element type, a FreeSpace one would have elements of no size
+            if(type == FreeSpace || type > Double) {
+                trace.fail();
+            }
+            const char *values = NULL;
+            if(op == TraceSet && trace.ok()) {
+                uint64_t size = (uint64_t)count * getDataTypeSize((DataType)type);
+                if(size > TRACE_MAX_LENGTH) {
+                    trace.fail();
+                } else {
+                    values = trace.getBytes(size);
                 }
+            }
+            if(!trace.ok()) {
                 break;
-            case IN_WORD:
-                if (c == d)
-                {
-                    result.push_back(token);
-                    state = NONE;
+            }
+
+            Process* process = mmu->acquireProcess(pid);
+            if(process == NULL) {
+                printf("error: process not found\n");
+                break;
+            }
+            Variable* variable = mmu->getVariableByProcessAndName(process, var_name);
+            if(op == TraceAllocate) {
+                if(variable != NULL) {
+                    printf("error: variable already exists\n");
+                } else {
+                    int virtual_addr = allocateVariable(pid, var_name, (DataType)type, count, mmu, page_table);
+                    if(virtual_addr > -1) {
+                        printf("%d\n", virtual_addr);
+                    }
                 }
-                else
-                {
-                    token += c;
+            } else if(variable == NULL) {
+                printf("error: variable not found\n");
+            } else if(op == TraceFree) {
+                launchFreeVariable(pid, var_name, mmu, page_table, memory);
+            } else if(variable->type != type || offset >= variable->size / getDataTypeSize(variable->type) ||
+                      count > variable->size / getDataTypeSize(variable->type) - offset) {
+                printf("error: variable does not match the trace\n");
+            } else if(!setVariableElements(pid, variable, offset, values, count, page_table, memory)) {
+                printf("error: allocation exceeds system memory.\n");
+            }
+            mmu->releaseProcess(process);
+            break;
+        }
+        case TraceTerminate:
+        case TraceFork:
+        case TraceCompact:
+            pid = trace.getVarint();
+            if(!trace.ok()) {
+                break;
+            }
+            if(mmu->getProcessByPID(pid) == NULL) {
+                printf("error: process not found\n");
+            } else if(op == TraceTerminate) {
+                terminateProcess(pid, mmu, page_table);
+            } else if(op == TraceCompact) {
+                launchCompact(std::vector<uint32_t>(1, pid), mmu, page_table, memory);
+            } else {
+                uint32_t child_pid = forkProcess(pid, mmu, page_table);
+                if(child_pid == (uint32_t)-1) {
+                    printf("error: could not copy swapped out pages\n");
+                } else {
+                    printf("%u\n", child_pid);
                 }
+            }
+            break;
+        case TraceCompactAll:
+            launchCompact(mmu->getPIDs(), mmu, page_table, memory);
+            break;
+        case TraceShmCreate:
+        case TraceShmDestroy: {
+            const std::string& name = trace.getName();
+            uint64_t size = op == TraceShmCreate ? trace.getVarint() : 0;
+            if(op == TraceShmCreate && (size == 0 || size > UINT32_MAX)) {
+                trace.fail();
+            }
+            if(!trace.ok()) {
                 break;
-            case IN_STRING:
-                if (c == '\"')
-                {
-                    result.push_back(token);
-                    state = NONE;
+            }
+            if(op == TraceShmDestroy) {
+                if(!page_table->destroySegment(name)) {
+                    printf("error: segment not found\n");
                 }
-                else
-                {
-                    token += c;
+            } else if(page_table->getSegmentSize(name) != 0) {
+                printf("error: segment already exists\n");
+            } else if(!page_table->createSegment(name, size)) {
+                printf("error: allocation exceeds system memory.\n");
+            }
+            break;
+        }
+        case TraceShmAttach:
+        case TraceShmDetach: {
+            pid = trace.getVarint();
+            const std::string& name = trace.getName();
+            if(!trace.ok()) {
+                break;
+            }
+            if(op == TraceShmAttach) {
+                int virtual_addr = attachSegment(pid, name, mmu, page_table);
+                if(virtual_addr > -1) {
+                    printf("%d\n", virtual_addr);
                 }
+            } else if(mmu->getProcessByPID(pid) == NULL) {
+                printf("error: process not found\n");
+            } else if(!detachSegment(pid, name, mmu, page_table)) {
+                printf("error: segment not attached\n");
+            }
+            break;
+        }
+        case TraceDump: {
+            const std::string& object = trace.getName();
+            const std::string& path = trace.getName();
+            bool text = trace.getVarint() != 0;
+            if(trace.ok()) {
+                launchDump(object, path, text, mmu, page_table, memory);
+            }
+            break;
+        }
+        case TracePrint: {
+            const std::string& object = trace.getName();
+            if(trace.ok()) {
+                printCommand(object, mmu, page_table, memory, stats);
+            }
+            break;
+        }
+        case TraceSave:
+        case TraceLoad: {
+            const std::string& path = trace.getName();
+            if(!trace.ok()) {
                 break;
+            }
+            if(op == TraceLoad) {
+                loadSnapshot(path, mmu, page_table, physical_memory);
+            } else if(!saveSnapshot(path, mmu, page_table, physical_memory)) {
+                printf("error: could not write \"%s\"\n", path.c_str());
+            }
+            break;
         }
+        default:
+            trace.fail();
+            break;
     }
-    if (state != NONE)
-    {
-        result.push_back(token);
+}
+
+/** Counts a command that was just run, and writes the statistics file when it is due.
+ *  @param command Index of the command, from CommandStats::getCommand.
+ *  @param start When the command started (unused if built with MEMSIM_NO_STATS).
+ *  @param stats Command statistics.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ */
+void finishCommand(int command, std::chrono::steady_clock::time_point start, CommandStats *stats, Mmu *mmu, PageTable *page_table) {
+    if(STATS_ENABLED) {
+        stats->record(command, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    if(stats->isOutputDue() && !writeStatsFile(stats->getOutputPath(), stats, mmu, page_table)) {
+        fprintf(stderr, "Error: could not write statistics '%s'\n", stats->getOutputPath().c_str());
+    }
+}
+
+/** Writes every statistic to a JSON file. The file is written next to its final path and renamed over it, so a reader
+ *  never sees a partial file.
+ *  @param path File to write.
+ *  @param stats Command statistics.
+ *  @param mmu Pointer to the mmu.
+ *  @param page_table Pointer to the page table.
+ *  @return True if the file was written. False otherwise.
+ */
+bool writeStatsFile(const std::string& path, CommandStats *stats, Mmu *mmu, PageTable *page_table) {
+    std::string temp_path = path + ".tmp";
+    FILE *file = fopen(temp_path.c_str(), "w");
+    if(file == NULL) {
+        return false;
+    }
+    fprintf(file, "{\n  \"enabled\": %s,\n  \"commands\": {", STATS_ENABLED ? "true" : "false");
+    stats->writeJson(file);
+    fprintf(file, "\n  },\n  \"mmu\": ");
+    mmu->writeStatsJson(file);
+    fprintf(file, ",\n  \"page_table\": ");
+    page_table->writeStatsJson(file);
+    fprintf(file, "\n}\n");
+    if(fclose(file) != 0 || rename(temp_path.c_str(), path.c_str()) != 0) {
+        remove(temp_path.c_str());
+        return false;
     }
+    return true;
 }
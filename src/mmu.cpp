@@ -2,72 +2,94 @@
 #include <algorithm>
 #include <cmath>
 
-Mmu::Mmu(int memory_size)
+Mmu::Mmu(uint32_t memory_size)
 {
     _next_pid = 1024;
     _max_size = memory_size;
+    _placement = BestFit;
+    _heap = FreeListHeap;
+    _slab_enabled = false;
+    _compact_threshold = 0;
 }
 
 Mmu::~Mmu()
 {
+    for (int i = 0; i < MMU_PROCESS_SHARDS; i++)
+    {
+        std::unordered_map<uint32_t, Process*>::iterator it;
+        for (it = _shards[i].processes.begin(); it != _shards[i].processes.end(); it++)
+        {
+            deleteProcess(it->second);
+        }
+    }
 }
 
 uint32_t Mmu::createProcess()
 {
-    Process *proc = new Process();
-    proc->pid = _next_pid;
-
-    Variable *var = new Variable();
-    var->name = "<FREE_SPACE>";
-    var->type = DataType::FreeSpace;
-    var->virtual_address = 0;
-    var->size = _max_size;
-    proc->variables.push_back(var);
+    Process *proc;
+    {
+        std::lock_guard<std::mutex> guard(_pool_lock);
+        proc = _process_pool.create();
+    }
+    proc->pid = _next_pid++;
+    proc->references = 0;
+    proc->terminated = false;
 
-    _processes.push_back(proc);
+    // The whole virtual address space starts out free
+    if (_heap == BuddyHeap)
+    {
+        proc->buddy.init(_max_size);
+    }
+    else
+    {
+        proc->free_space.insert(0, _max_size);
+    }
 
-    _next_pid++;
+    ProcessShard& shard = getShard(proc->pid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.processes[proc->pid] = proc;
     return proc->pid;
 }
 
 void Mmu::addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint32_t size, uint32_t address)
 {
-    int i;
-    Process *proc = NULL;
-    for (i = 0; i < _processes.size(); i++) // add condition to leave process loop once process found? optimization
+    Process *proc = getProcessByPID(pid);
+    if (proc == NULL)
     {
-        if (_processes[i]->pid == pid)
-        {
-            proc = _processes[i];
-        }
+        return;
     }
 
-    Variable *var = new Variable();
+    Variable *var = proc->variable_pool.create();
     var->name = var_name;
     var->type = type;
     var->virtual_address = address;
     var->size = size;
-    if (proc != NULL)
-    {
-        proc->variables.push_back(var);
-    }
+    proc->variables.insert(std::make_pair(address, var));
+    proc->names[var_name] = var;
 }
 
 void Mmu::print()
 {
-    int i, j;
+    int i;
 
-    std::cout << " PID  | Variable Name | Virtual Addr | Size" << std::endl;
-    std::cout << "------+---------------+--------------+------------" << std::endl;
-    for (i = 0; i < _processes.size(); i++)
+    printf(" PID  | Variable Name | Virtual Addr | Size\n");
+    printf("------+---------------+--------------+------------\n");
+    std::vector<uint32_t> pids = getPIDs();
+    for (i = 0; i < pids.size(); i++)
     {
-        for (j = 0; j < _processes[i]->variables.size(); j++)
+        // Lock each process while its variables are listed, skipping any terminated in the meantime
+        Process *proc = acquireProcess(pids[i]);
+        if (proc == NULL)
         {
-            Variable* v = _processes[i]->variables[j];
-            if(v->type != FreeSpace) {
-                printf(" %4d | %-14s|   0x%08X |%11d\n", _processes[i]->pid, v->name.c_str(), v->virtual_address, v->size);
-            }
+            continue;
+        }
+        std::multimap<uint32_t, Variable*>::iterator it;
+        for (it = proc->variables.begin(); it != proc->variables.end(); it++)
+        {
+            Variable* v = it->second;
+            printf(" %4d | %-14s|   0x%08X |%11d\n", proc->pid, v->name.c_str(), v->virtual_address, v->size);
         }
+        releaseProcess(proc);
     }
 }
 
@@ -83,133 +105,87 @@ void Mmu::print()
  * @return A pointer to the variable with the given name in the given process. Or returns NULL is it does not exist.
  */
 Variable* Mmu::getVariableByProcessAndName(Process* process, std::string name) {
-    for(int i=0; i<process->variables.size(); i++) {
-        if(process->variables[i]->name == name) {
-            return process->variables[i];
-        }
+    std::unordered_map<std::string, Variable*>::iterator it = process->names.find(name);
+    if(it == process->names.end()) {
+        return NULL;
     }
-    return NULL;
+    return it->second;
 }
 
-/** Gets the whole list of processes from the MMU.
- * @return The list of processes.
+/** Gets the PIDs of all processes in the MMU. Processes may be created or terminated as soon as it returns.
+ * @return The list of PIDs, in ascending order.
  */
-std::vector<Process*> Mmu::getProcessesVector() {
-    return _processes;
+std::vector<uint32_t> Mmu::getPIDs() {
+    std::vector<uint32_t> pids;
+    for(int i = 0; i < MMU_PROCESS_SHARDS; i++) {
+        std::lock_guard<std::mutex> guard(_shards[i].lock);
+        std::unordered_map<uint32_t, Process*>::iterator it;
+        for(it = _shards[i].processes.begin(); it != _shards[i].processes.end(); it++) {
+            pids.push_back(it->first);
+        }
+    }
+    std::sort(pids.begin(), pids.end());
+    return pids;
 }
 
-/** Gets a pointer to a process by the pid.
+/** Gets a pointer to a process by the pid. The caller must hold the process (see acquireProcess) for the pointer to
+ *  stay valid.
  * @param pid The Process ID of the process to retrieve.
  * @return A pointer to the process, or NULL if no process with that PID is found.
  */
 Process* Mmu::getProcessByPID(int pid) {
-    int i;
-    for(i = 0; i < _processes.size(); i++) {
-        if(_processes[i]->pid == pid) return _processes[i];
-    }
-    return NULL;
+    ProcessShard& shard = getShard(pid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    std::unordered_map<uint32_t, Process*>::iterator it = shard.processes.find(pid);
+    if(it == shard.processes.end()) return NULL;
+    return it->second;
 }
 
-/** Gets a vector of all the free spaces within the process provided.
- * @param pid The PID of the process to get free spaces for.
- * @return A Vector of all the free spaces within the process.
+/** Locks a process for the calling thread. Calls may nest, each must be matched by releaseProcess. Threads operating
+ *  on different processes never wait for each other.
+ * @param pid The Process ID of the process to lock.
+ * @return A pointer to the locked process, or NULL if no process with that PID is found (or it was terminated while
+ *         waiting for the lock).
  */
-std::vector<Variable*> Mmu::getFreeSpaceVector(int pid) {
-    // loop through each variable for process with pid
-    Process* p = getProcessByPID(pid);
-    std::vector<Variable*> freeSpaceVariables;
-
-    int i;
-    for(i = 0; i < p->variables.size(); i++) {
-        Variable* v = p->variables[i];
-        if(v->type == FreeSpace) freeSpaceVariables.push_back(v);
-    }
-
-    return freeSpaceVariables;
-}
-
-/** Searches page for free space to allocate variable to
- * @param pid PID of process to search.
- * @param page Page to search within.
- * @param size Type size of the variable.
- * @param page_size Total size of the page.
- * @param num_elements Number of elements to accomodate.
- * @return Virtual memory address where space is found within the page. -1 if no space found in the page.
- */
-uint32_t Mmu::getFreeSpaceInPage(int pid, int page, int size, int page_size, int num_elements)
-{
-    std::vector<Variable*> free_spaces = getFreeSpaceVector(pid);
-    std::vector<Variable*> free_spaces_in_page;
-
-    int offset_size = (int)log2((double)page_size);
-    int array_size = size * num_elements;
-    int space_left_in_page;
-
-    for(int i = 0; i < free_spaces.size(); i++)
+Process* Mmu::acquireProcess(uint32_t pid) {
+    ProcessShard& shard = getShard(pid);
+    Process *process;
     {
-        // if the free space is in the page
-        if(free_spaces[i]->virtual_address >> offset_size == page) {
-            free_spaces_in_page.push_back(free_spaces[i]);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        std::unordered_map<uint32_t, Process*>::iterator it = shard.processes.find(pid);
+        if(it == shard.processes.end()) {
+            return NULL;
         }
+        process = it->second;
+        process->references++;
     }
 
-    // For each free space, check for a full fit
-    for(int i = 0; i < free_spaces_in_page.size(); i++)
-    {
-        Variable* free_space = free_spaces_in_page[i];
-        space_left_in_page = page_size - (free_space->virtual_address % page_size);
-
-        if(array_size <= space_left_in_page)
-        {
-            // the whole array fits in the page, return the address
-            return free_space->virtual_address;
-        }
+    // The reference keeps the process alive while waiting, the shard is not held so other PIDs are not blocked
+    process->lock.lock();
+    if(process->terminated) {
+        releaseProcess(process);
+        return NULL;
     }
+    return process;
+}
 
-    int byte_overrun;
+/** Unlocks a process locked by acquireProcess, freeing it if it was terminated and this was the last reference.
+ * @param process The process to unlock.
+ */
+void Mmu::releaseProcess(Process *process) {
+    process->lock.unlock();
 
-    // For each free space, check for a partial fit
-    for(int i = 0; i < free_spaces_in_page.size(); i++)
+    bool last;
     {
-        Variable* free_space = free_spaces_in_page[i];
-        space_left_in_page = page_size - (free_space->virtual_address % page_size);
-        byte_overrun = (space_left_in_page % size);
-
-        // check that the first element fits 
-        if(size <= space_left_in_page && size <= free_space->size) {
-                // If is array and crosses page borders
-                if(num_elements > 1 && array_size > space_left_in_page)
-                {
-                    // If an element exists overrunning the boundary
-                    if(byte_overrun != 0)
-                    {
-                        // If the array still fits in the free space
-                        if(size <= free_space->size - byte_overrun)
-                        {
-                            // return the new address
-                            return free_space->virtual_address + byte_overrun;
-                            // if not, move on to the next free space
-                        }
-                    } else {
-                        // No bytes overrun and still fits, return address
-                        return free_space->virtual_address;
-                    }
-                } else {
-                    return free_space->virtual_address;
-                }
-            }
-            // Else, if the first element fits at the beginning of the next page.
-            else if(size <= free_space->size - space_left_in_page)
-            {
-                return free_space->virtual_address;
-            }
+        std::lock_guard<std::mutex> guard(getShard(process->pid).lock);
+        last = --process->references == 0 && process->terminated;
+    }
+    if(last) {
+        deleteProcess(process);
     }
-
-    // If here, no good spot found.
-    return -1;
 }
 
-/** Gets free space anywhere in the pid's virtual memory
+/** Gets free space anywhere in the pid's virtual memory, chosen by the MMU's placement policy (or the buddy system)
  * @param pid PID of the process to search.
  * @param size Size of first element in bytes.
  * @param page_size Size of one page.
@@ -218,49 +194,18 @@ uint32_t Mmu::getFreeSpaceInPage(int pid, int page, int size, int page_size, int
  */
 uint32_t Mmu::getFreeSpaceAnywhere(int pid, int size, int page_size, int num_elements) {
     Process* p = getProcessByPID(pid);
-    
-    // for each free space in process
-    for(int vi = 0; vi < p->variables.size(); vi++) {
-        Variable* v = p->variables[vi];
-        if(v->type != FreeSpace) {
-            continue;
-        } else {
-            // if the free space address can fit the var and free space addr + size does not overflow page boundaries, return the free space address 
-            int array_size = size * num_elements;
-            int space_left_in_page = page_size - (v->virtual_address % page_size);
-            int byte_overrun = (space_left_in_page % size);
-
-            // If first element fits inside free space ON PAGE
-            if(size <= space_left_in_page && size <= v->size) {
-                // If is array and crosses page borders
-                if(num_elements > 1 && array_size > space_left_in_page)
-                {
-                    // If an element exists overrunning the boundary
-                    if(byte_overrun != 0)
-                    {
-                        // If the array still fits in the free space
-                        if(size <= v->size - byte_overrun)
-                        {
-                            // return the new address
-                            return v->virtual_address + byte_overrun;
-                            // if not, move on to the next free space
-                        }
-                    } else {
-                        // No bytes overrun and still fits, return address
-                        return v->virtual_address;
-                    }
-                } else {
-                    return v->virtual_address;
-                }
-            }
-            // Else, if the first element fits at the beginning of the next page.
-            else if(size <= v->size - space_left_in_page)
-            {
-                return v->virtual_address;
-            }
-        }
+    uint32_t address;
+    if(_heap == BuddyHeap) {
+        address = p->buddy.find((uint32_t)size * num_elements);
+        STATS(_searches.record(p->buddy.getLastProbes()));
+    } else {
+        address = p->free_space.find(_placement, size, page_size, num_elements);
+        STATS(_searches.record(p->free_space.getLastProbes()));
+    }
+    if(address == -1) {
+        STATS(_allocation_failures.add());
     }
-    return -1;
+    return address;
 }
 
 /** Updates free space to accomodate newly allocated variables.
@@ -270,29 +215,11 @@ uint32_t Mmu::getFreeSpaceAnywhere(int pid, int size, int page_size, int num_ele
  */
 void Mmu::updateFreeSpace(int pid, int virtual_address, int size) {
     Process* p = getProcessByPID(pid);
-    for(int vi = 0; vi < p->variables.size(); vi++) {
-        Variable* v = p->variables[vi];
-        if(v->type != FreeSpace) {
-            continue;
-        } else {
-            // check if the free space contains the provided slice
-            if(v->virtual_address <= virtual_address && v->virtual_address + v->size >= virtual_address + size) {
-                int left_slice = virtual_address - v->virtual_address;
-                int right_slice = v->size - (left_slice + size);
-                // if a left slice exists, set the original to the left slice and add a new right free space of the remaining size. otherwise, set the original to the right slice
-                if(left_slice > 0) {
-                    v->size = left_slice;
-                    if(right_slice > 0) {
-                        addVariableToProcess(pid, "<FREE_SPACE>", FreeSpace, right_slice, virtual_address + size);
-                    }
-                } else {
-                    v->virtual_address = virtual_address + size;
-                    v->size = right_slice;
-                }
-            }
-        }
+    if(_heap == BuddyHeap) {
+        p->buddy.reserve(virtual_address, size);
+    } else {
+        p->free_space.reserve(virtual_address, size);
     }
-
 }
 
 /** Removes a varaible from a process and modifies free space to accomodate.
@@ -302,89 +229,35 @@ void Mmu::updateFreeSpace(int pid, int virtual_address, int size) {
  */
 bool Mmu::removeVariable(int pid, std::string var_name)
 {
-    // Check all variables for var_name
     Process* p = getProcessByPID(pid);
-    Variable* var_to_remove = NULL;
-    int var_to_remove_index = -1;
-    for(int vi = 0; vi < p->variables.size() && var_to_remove_index == -1; vi++)
+    Variable* var_to_remove = getVariableByProcessAndName(p, var_name);
+    if(var_to_remove == NULL)
     {
-        Variable* v = p->variables[vi];
-        if(v->name == var_name)
-        {
-            var_to_remove = v;
-            var_to_remove_index = vi;
-        }
+        return false;
     }
-    
-    // If var_to_remove_index is still -1, variable with var_name was not found. Return false
-    if(var_to_remove_index == -1 || var_to_remove == NULL)
-    {
-        return NULL;
-    }
-    
-    // var_to_remove was set, so we analyze free space around the variable to see if we need to merge
-    
-    Variable* free_space_before = NULL;
-    Variable* free_space_after = NULL;
 
-    // Loop through all free spaces
-    for(int vi = 0; vi < p->variables.size(); vi++)
+    // Drop the variable from the name index and the address map
+    p->names.erase(var_to_remove->name);
+    std::pair<std::multimap<uint32_t, Variable*>::iterator, std::multimap<uint32_t, Variable*>::iterator> range;
+    range = p->variables.equal_range(var_to_remove->virtual_address);
+    for(std::multimap<uint32_t, Variable*>::iterator it = range.first; it != range.second; it++)
     {
-        Variable* v = p->variables[vi];
-        if(v->type == FreeSpace)
-        {   
-            // if the free space is directly before our variable
-            if(v->virtual_address + v->size == var_to_remove->virtual_address)
-            {
-                // set the before free space
-                free_space_before = v;
-            }
-
-            // if the free space is directly after our variable
-            if(v->virtual_address == var_to_remove->virtual_address + var_to_remove->size)
-            {
-                // set the after free space
-                free_space_after = v;
-            }
+        if(it->second == var_to_remove)
+        {
+            p->variables.erase(it);
+            break;
         }
     }
 
-    if(free_space_before != NULL && free_space_after != NULL)
-    {
-        // Our variable is surrounded by free spaces.
-        // Grow the size of free_space_before by the size of our variable + free_space_after
-        free_space_before->size += var_to_remove->size + free_space_after->size;
-        // Remove our variable and free_space_after from the MMU
-        p->variables.erase(std::remove(p->variables.begin(), p->variables.end(), var_to_remove), p->variables.end());
-        p->variables.erase(std::remove(p->variables.begin(), p->variables.end(), free_space_after), p->variables.end());
-        
-
-    }
-    else if(free_space_before != NULL)
-    {
-        // Our variable only has free space before it.
-        // Grow the size of free_space_before by the size of our variable
-        free_space_before->size += var_to_remove->size;
-        // Remove our variable from the MMU
-        p->variables.erase(std::remove(p->variables.begin(), p->variables.end(), var_to_remove), p->variables.end());
-    }
-    else if(free_space_after != NULL) 
-    {
-        // Our variable only has free space after it
-        // Set the virtual address of free_space_after to the virtual address of our variable
-        free_space_after->virtual_address = var_to_remove->virtual_address;
-        // Grow the free_space_after size by the size of our varaible
-        free_space_after->size += var_to_remove->size;
-        // Remove our variable from the MMU
-        p->variables.erase(std::remove(p->variables.begin(), p->variables.end(), var_to_remove), p->variables.end());
-    }
-    else 
-    {
-        // Our variable has no free space around it.
-        // Set our variable to a free space
-        var_to_remove->name = "<FREE_SPACE>";
-        var_to_remove->type = FreeSpace;
+    // Return its space, merging with the free space around it
+    if(p->slabs.contains(var_to_remove->virtual_address)) {
+        freeSlabSlot(pid, var_to_remove->virtual_address);
+    } else if(_heap == BuddyHeap) {
+        p->buddy.release(var_to_remove->virtual_address, var_to_remove->size);
+    } else {
+        p->free_space.release(var_to_remove->virtual_address, var_to_remove->size);
     }
+    p->variable_pool.destroy(var_to_remove);
     return true;
 }
 
@@ -397,50 +270,43 @@ bool Mmu::removeVariable(int pid, std::string var_name)
 std::vector<int> Mmu::getExclusivePages(int pid, std::string var_name, int page_size)
 {
     Process* p = getProcessByPID(pid);
-    Variable* var = NULL;
-    for(int vi = 0; vi < p->variables.size(); vi++)
-    {
-        Variable* this_variable = p->variables[vi];
-        if(this_variable->name == var_name)
-        {
-            var = this_variable;
-        }
-    }
+    Variable* var = getVariableByProcessAndName(p, var_name);
 
     std::vector<int> exclusive_pages;
 
-
-    if(var != NULL) {;
+    if(var != NULL) {
         // Get the root and end pages, and push all pages in that range to the vector.
         int offset_length = (int)log2((double)page_size);
         int root_page = var->virtual_address >> offset_length;
         int end_page = (var->virtual_address + var->size) >> offset_length;
-        for(int i = root_page; i <= end_page; i++) 
+
+        // Variables never overlap, so only the nearest variables on either side can share the root or end page.
+        // Walk outwards from the variable until the neighbours no longer touch its page range.
+        std::multimap<uint32_t, Variable*>::iterator self = p->variables.lower_bound(var->virtual_address);
+        while(self->second != var) self++;
+
+        std::multimap<uint32_t, Variable*>::iterator it = self;
+        while(it != p->variables.begin())
         {
-            exclusive_pages.push_back(i);
+            it--;
+            int vi_end_page = (it->second->virtual_address + it->second->size) >> offset_length;
+            if(vi_end_page < root_page) break;
+            root_page = vi_end_page + 1;
         }
-        
-        // For each other non-freespace variable, check if the pages exist in the vector. If they do, they're not exclusive. Remove them.
-        for(int vi = 0; vi < p->variables.size(); vi++)
+
+        for(it = self, it++; it != p->variables.end(); it++)
         {
-            // If the variable is not freespace and not the original var
-            if(p->variables[vi]->type != FreeSpace && p->variables[vi] != var)
-            {
-                // Get the page range for this variable
-                int vi_root_page = p->variables[vi]->virtual_address >> offset_length;
-                int vi_end_page = (p->variables[vi]->virtual_address + p->variables[vi]->size) >> offset_length;
-                for(int page_i = vi_root_page; page_i <= vi_end_page; page_i++)
-                {
-                    if(page_i >= root_page && page_i <= end_page) {
-                        // Remove the element from the page if it exists
-                        exclusive_pages.erase(std::remove(exclusive_pages.begin(), exclusive_pages.end(), page_i), exclusive_pages.end());
-                    }
-                }
-            }
+            int vi_root_page = it->second->virtual_address >> offset_length;
+            if(vi_root_page > end_page) break;
+            end_page = vi_root_page - 1;
+        }
+
+        for(int i = root_page; i <= end_page; i++)
+        {
+            exclusive_pages.push_back(i);
         }
-        
     }
-    
+
     return exclusive_pages;
 }
 
@@ -452,25 +318,410 @@ std::vector<int> Mmu::getExclusivePages(int pid, std::string var_name, int page_
 bool Mmu::variableExists(int pid, std::string var_name)
 {
     Process* p = getProcessByPID(pid);
-    for(int i = 0; i < p->variables.size(); i++)
+    return getVariableByProcessAndName(p, var_name) != NULL;
+}
+
+/** Removes process with pid from the process table. The caller must hold the process, its state is freed when the
+ *  last thread holding it releases it.
+ * @param pid PID of the process to remove.
+ */
+void Mmu::removeProcess(int pid) {
+    ProcessShard& shard = getShard(pid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    std::unordered_map<uint32_t, Process*>::iterator it = shard.processes.find(pid);
+    if(it == shard.processes.end()) {
+        return;
+    }
+    it->second->terminated = true;
+    shard.processes.erase(it);
+}
+
+/** Frees a process and every variable it owns. The variables' slabs go back to the heap together with the
+ *  process' arena.
+ * @param process The process to delete.
+ */
+void Mmu::deleteProcess(Process *process) {
+    std::multimap<uint32_t, Variable*>::iterator it;
+    for(it = process->variables.begin(); it != process->variables.end(); it++) {
+        process->variable_pool.destroy(it->second);
+    }
+    std::lock_guard<std::mutex> guard(_pool_lock);
+    _process_pool.destroy(process);
+}
+
+/** Gets the shard holding a process.
+ * @param pid PID of the process.
+ * @return The shard the PID maps to.
+ */
+ProcessShard& Mmu::getShard(uint32_t pid) {
+    return _shards[pid % MMU_PROCESS_SHARDS];
+}
+/** Sets how new variables are placed in free space. Must be set before any process is created.
+ * @param policy The placement policy.
+ */
+void Mmu::setPlacementPolicy(PlacementPolicy policy) {
+    _placement = policy;
+}
+
+/** Gets how new variables are placed in free space.
+ * @return The placement policy.
+ */
+PlacementPolicy Mmu::getPlacementPolicy() {
+    return _placement;
+}
+
+/** Sets how free virtual memory is tracked. Must be set before any process is created.
+ * @param heap The heap back end.
+ */
+void Mmu::setHeapBackend(HeapBackend heap) {
+    _heap = heap;
+}
+
+/** Gets how free virtual memory is tracked.
+ * @return The heap back end.
+ */
+HeapBackend Mmu::getHeapBackend() {
+    return _heap;
+}
+
+/** Prints how much of each process' virtual memory is lost to fragmentation. Internal fragmentation is the space
+ *  reserved beyond what variables asked for (buddy blocks rounded up to a power of two), external fragmentation is
+ *  free space outside the largest free block.
+ */
+void Mmu::printFragmentation() {
+    printf("Heap: %s\n", _heap == BuddyHeap ? "buddy" : "free list");
+    printf(" PID  | Requested  | Reserved   | Internal | Free        | Largest Free | External\n");
+    printf("------+------------+------------+----------+-------------+--------------+----------\n");
+    std::vector<uint32_t> pids = getPIDs();
+    for(int i = 0; i < pids.size(); i++) {
+        Process *proc = acquireProcess(pids[i]);
+        if(proc == NULL) {
+            continue;
+        }
+
+        uint64_t requested = 0;
+        std::multimap<uint32_t, Variable*>::iterator it;
+        for(it = proc->variables.begin(); it != proc->variables.end(); it++) {
+            requested += it->second->size;
+        }
+        // Slab slots are charged as whole slab pages
+        uint64_t reserved = requested - proc->slabs.getUsedBytes() + proc->slabs.getSlabBytes();
+        uint64_t free_bytes = proc->free_space.getFreeBytes();
+        uint64_t largest = proc->free_space.getLargest();
+        if(_heap == BuddyHeap) {
+            reserved = proc->buddy.getReservedBytes();
+            free_bytes = proc->buddy.getFreeBytes();
+            largest = proc->buddy.getLargestFree();
+        }
+        releaseProcess(proc);
+
+        double internal = reserved == 0 ? 0.0 : 100.0 * (reserved - requested) / reserved;
+        double external = free_bytes == 0 ? 0.0 : 100.0 * (free_bytes - largest) / free_bytes;
+        printf(" %4u | %10llu | %10llu | %7.2f%% | %11llu | %12llu | %7.2f%%\n", pids[i],
+               (unsigned long long)requested, (unsigned long long)reserved, internal,
+               (unsigned long long)free_bytes, (unsigned long long)largest, external);
+    }
+}
+
+/** Sets whether single elements of a power of two size up to SLAB_MAX_SIZE are allocated from slabs
+ * @param enabled True to use slabs.
+ */
+void Mmu::setSlabEnabled(bool enabled) {
+    _slab_enabled = enabled;
+}
+
+/** Checks whether small single elements are allocated from slabs
+ * @return True if slabs are used.
+ */
+bool Mmu::isSlabEnabled() {
+    return _slab_enabled;
+}
+
+/** Allocates a slot for a single small element, taking a new page from the heap for the slab when its size class
+ *  has no free slot
+ * @param pid PID of the process allocating.
+ * @param size Size of the element in bytes.
+ * @param page_size Size of one page.
+ * @return Virtual address of the slot. -1 if there is no free page for a new slab.
+ */
+uint32_t Mmu::allocateFromSlab(int pid, int size, int page_size) {
+    Process* p = getProcessByPID(pid);
+    uint32_t address = p->slabs.allocate(size);
+    if(address != -1) {
+        return address;
+    }
+
+    // A page sized block with page sized elements is always placed on a page boundary
+    uint32_t page_address = getFreeSpaceAnywhere(pid, page_size, page_size, 1);
+    if(page_address == -1) {
+        return -1;
+    }
+    updateFreeSpace(pid, page_address, page_size);
+    p->slabs.addSlab(size, page_address, page_size);
+    return p->slabs.allocate(size);
+}
+
+/** Frees a slab slot, returning the slab's page to the heap if it is left empty
+ * @param pid PID of the process freeing.
+ * @param virtual_address Virtual address of the slot.
+ */
+void Mmu::freeSlabSlot(int pid, uint32_t virtual_address) {
+    Process* p = getProcessByPID(pid);
+    uint32_t page_address = p->slabs.release(virtual_address);
+    if(page_address == -1) {
+        return;
+    }
+    if(_heap == BuddyHeap) {
+        p->buddy.release(page_address, p->slabs.getPageSize());
+    } else {
+        p->free_space.release(page_address, p->slabs.getPageSize());
+    }
+}
+
+/** Moves a variable to a new virtual address. Only the variable's record changes, the caller copies its data and
+ *  rebuilds the free space afterwards.
+ * @param pid PID of the process owning the variable.
+ * @param variable The variable to move.
+ * @param virtual_address New virtual address of the variable.
+ */
+void Mmu::moveVariable(int pid, Variable *variable, uint32_t virtual_address) {
+    Process* p = getProcessByPID(pid);
+    std::pair<std::multimap<uint32_t, Variable*>::iterator, std::multimap<uint32_t, Variable*>::iterator> range;
+    range = p->variables.equal_range(variable->virtual_address);
+    for(std::multimap<uint32_t, Variable*>::iterator it = range.first; it != range.second; it++)
     {
-        if(p->variables[i]->name == var_name)
+        if(it->second == variable)
         {
-            return true;
+            p->variables.erase(it);
+            break;
         }
     }
-    return false;
+    variable->virtual_address = virtual_address;
+    p->variables.insert(std::make_pair(virtual_address, variable));
 }
 
-/** Removes process with pid from the processes vector
- * @param pid PID of the process to remove.
+/** Rebuilds a process' free list from the gaps between its variables and slabs
+ * @param pid PID of the process.
  */
-void Mmu::removeProcess(int pid) {
-    for(int i = 0; i < _processes.size(); i++)
+void Mmu::rebuildFreeSpace(int pid) {
+    Process* p = getProcessByPID(pid);
+    uint32_t slab_page_size = p->slabs.getPageSize();
+    p->free_space = FreeSpaceIndex();
+
+    uint64_t cursor = 0;
+    std::multimap<uint32_t, Variable*>::iterator it;
+    for(it = p->variables.begin(); it != p->variables.end(); it++) {
+        uint64_t start = it->second->virtual_address;
+        uint64_t end = start + it->second->size;
+        // Slab slots occupy their whole slab page
+        if(p->slabs.contains(it->second->virtual_address)) {
+            start -= start % slab_page_size;
+            end = start + slab_page_size;
+        }
+        if(start > cursor) {
+            p->free_space.insert(cursor, start - cursor);
+        }
+        cursor = std::max(cursor, end);
+    }
+    if(cursor < _max_size) {
+        p->free_space.insert(cursor, _max_size - cursor);
+    }
+}
+
+/** Gets how much of a process' heap is lost to holes: free space below the end of its highest variable, as a
+ *  percentage of that end address. Only meaningful for the free list heap, the buddy heap always reports 0.
+ * @param pid PID of the process.
+ * @return Percentage of the used address range that is free.
+ */
+int Mmu::getHolePercent(int pid) {
+    Process* p = getProcessByPID(pid);
+    if(_heap == BuddyHeap || p->variables.empty()) {
+        return 0;
+    }
+
+    Variable *last = p->variables.rbegin()->second;
+    uint64_t end = (uint64_t)last->virtual_address + last->size;
+    if(p->slabs.contains(last->virtual_address)) {
+        end = last->virtual_address - last->virtual_address % p->slabs.getPageSize() + p->slabs.getPageSize();
+    }
+    // Everything above the highest variable is a single free extent
+    uint64_t holes = p->free_space.getFreeBytes() - (_max_size - end);
+    return end == 0 ? 0 : (int)(100 * holes / end);
+}
+
+/** Sets the hole percentage at which freeing a variable compacts its process
+ * @param percent Threshold in percent, 0 to never compact automatically.
+ */
+void Mmu::setCompactThreshold(int percent) {
+    _compact_threshold = percent;
+}
+
+/** Gets the hole percentage at which freeing a variable compacts its process
+ * @return Threshold in percent, 0 if processes are never compacted automatically.
+ */
+int Mmu::getCompactThreshold() {
+    return _compact_threshold;
+}
+
+/** Creates a process with a copy of another process' variables and free space. The caller must hold the parent.
+ * @param parent_pid PID of the process to copy.
+ * @return PID of the new process.
+ */
+uint32_t Mmu::forkProcess(uint32_t parent_pid)
+{
+    Process *parent = getProcessByPID(parent_pid);
+    uint32_t pid = createProcess();
+    Process *child = acquireProcess(pid);
+
+    child->free_space = parent->free_space;
+    child->buddy = parent->buddy;
+    child->slabs = parent->slabs;
+    std::multimap<uint32_t, Variable*>::iterator it;
+    for (it = parent->variables.begin(); it != parent->variables.end(); it++)
     {
-        if(_processes[i]->pid == pid) {
-            _processes.erase(_processes.begin() + i);
-            return;
+        Variable *var = it->second;
+        addVariableToProcess(pid, var->name, var->type, var->size, var->virtual_address);
+    }
+
+    releaseProcess(child);
+    return pid;
+}
+
+/** Removes every process. No other thread may be holding a process.
+ */
+void Mmu::clear() {
+    for(int i = 0; i < MMU_PROCESS_SHARDS; i++) {
+        std::lock_guard<std::mutex> guard(_shards[i].lock);
+        std::unordered_map<uint32_t, Process*>::iterator it;
+        for(it = _shards[i].processes.begin(); it != _shards[i].processes.end(); it++) {
+            deleteProcess(it->second);
+        }
+        _shards[i].processes.clear();
+    }
+}
+
+/** Writes the heap settings and every process' variables and heap to a snapshot. No other thread may be changing
+ *  processes.
+ * @param writer Snapshot being written.
+ */
+void Mmu::save(SnapshotWriter& writer) {
+    writer.put<uint32_t>(_next_pid);
+    writer.put<uint8_t>(_placement);
+    writer.put<uint8_t>(_heap);
+    writer.put<uint8_t>(_slab_enabled);
+
+    std::vector<uint32_t> pids = getPIDs();
+    writer.put<uint32_t>(pids.size());
+    for(int i = 0; i < pids.size(); i++) {
+        Process *proc = acquireProcess(pids[i]);
+        writer.put<uint32_t>(proc->pid);
+        writer.put<uint32_t>(proc->variables.size());
+        std::multimap<uint32_t, Variable*>::iterator it;
+        for(it = proc->variables.begin(); it != proc->variables.end(); it++) {
+            writer.putString(it->second->name);
+            writer.put<uint8_t>(it->second->type);
+            writer.put<uint32_t>(it->second->virtual_address);
+            writer.put<uint32_t>(it->second->size);
+        }
+        if(_heap == BuddyHeap) {
+            proc->buddy.save(writer);
+        } else {
+            proc->free_space.save(writer);
         }
+        proc->slabs.save(writer);
+        releaseProcess(proc);
     }
-}
\ No newline at end of file
+}
+
+/** Replaces every process, and the heap settings, with those written by save. No other thread may be holding a
+ *  process.
+ * @param reader Snapshot being read.
+ * @return True if the processes were read. False if the snapshot is truncated or invalid, every process is then
+ *  removed and the settings are left as they were.
+ */
+bool Mmu::load(SnapshotReader& reader) {
+    clear();
+    uint32_t next_pid = reader.get<uint32_t>();
+    uint8_t placement = reader.get<uint8_t>();
+    uint8_t heap = reader.get<uint8_t>();
+    bool slab_enabled = reader.get<uint8_t>() != 0;
+    if(placement > WorstFit || heap > BuddyHeap) {
+        reader.fail();
+    }
+
+    uint32_t num_processes = reader.get<uint32_t>();
+    for(uint32_t i = 0; i < num_processes && reader.ok(); i++) {
+        Process *proc;
+        {
+            std::lock_guard<std::mutex> guard(_pool_lock);
+            proc = _process_pool.create();
+        }
+        proc->pid = reader.get<uint32_t>();
+        proc->references = 0;
+        proc->terminated = false;
+        {
+            ProcessShard& shard = getShard(proc->pid);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            if(shard.processes.count(proc->pid) != 0 || proc->pid >= next_pid) {
+                reader.fail();
+                deleteProcess(proc);
+                break;
+            }
+            shard.processes[proc->pid] = proc;
+        }
+
+        uint32_t num_variables = reader.get<uint32_t>();
+        for(uint32_t j = 0; j < num_variables && reader.ok(); j++) {
+            std::string name = reader.getString();
+            uint8_t type = reader.get<uint8_t>();
+            uint32_t virtual_address = reader.get<uint32_t>();
+            uint32_t size = reader.get<uint32_t>();
+            if(type == FreeSpace || type > Double || (uint64_t)virtual_address + size > _max_size ||
+               proc->names.count(name) != 0) {
+                reader.fail();
+                break;
+            }
+            addVariableToProcess(proc->pid, name, (DataType)type, size, virtual_address);
+        }
+        bool heap_read = heap == BuddyHeap ? proc->buddy.load(reader, _max_size) :
+                                             proc->free_space.load(reader, _max_size);
+        if(!heap_read || !proc->slabs.load(reader)) {
+            reader.fail();
+        }
+
+        // No variable may lie in memory the heap holds as free, or a later allocation would be placed on top of it
+        std::multimap<uint32_t, Variable*>::iterator it;
+        for(it = proc->variables.begin(); it != proc->variables.end() && reader.ok(); it++) {
+            Variable *variable = it->second;
+            if(heap == BuddyHeap ? proc->buddy.overlaps(variable->virtual_address, variable->size) :
+                                   proc->free_space.overlaps(variable->virtual_address, variable->size)) {
+                reader.fail();
+            }
+        }
+    }
+    if(!reader.ok()) {
+        clear();
+        return false;
+    }
+    _next_pid = next_pid;
+    _placement = (PlacementPolicy)placement;
+    _heap = (HeapBackend)heap;
+    _slab_enabled = slab_enabled;
+    return true;
+}
+
+/** Prints how long free space searches were and how many found nothing */
+void Mmu::printStats() {
+    printf("Free space (extents examined per search%s):\n", _heap == BuddyHeap ? ", orders for the buddy heap" : "");
+    _searches.print("searches:", "", 1.0);
+    printf("  %-22s %llu\n", "allocation failures:", (unsigned long long)_allocation_failures.get());
+}
+
+/** Writes the free space statistics as a JSON object
+ * @param file File to write to.
+ */
+void Mmu::writeStatsJson(FILE *file) {
+    fprintf(file, "{\"searches\": ");
+    _searches.writeJson(file, 1.0);
+    fprintf(file, ", \"allocation_failures\": %llu}", (unsigned long long)_allocation_failures.get());
+}
@@ -1,92 +1,136 @@
 #include "pagetable.h"
 #include <cmath>
+#include <cstring>
 
-PageTable::PageTable(int page_size)
+PageTable::PageTable(int page_size, uint32_t num_frames) : _frames(num_frames)
 {
     _page_size = page_size;
+    _offset_size = (int)log2((double)page_size);
+    _tlb = NULL;
+
+    FrameOwner no_owner = {0, -1};
+    _frame_owners.resize(num_frames, no_owner);
+    _frame_dirty.resize(num_frames, 0);
+
+    _memory = NULL;
+    _policy = NULL;
+    _swap = NULL;
+    _page_faults = 0;
+    _evictions = 0;
+    _writebacks = 0;
+    _num_shared = 0;
 }
 
 PageTable::~PageTable()
 {
+    for (int shard = 0; shard < PAGE_TABLE_SHARDS; shard++)
+    {
+        std::unordered_map<uint32_t, ProcessPageTable*>::iterator it;
+        for (it = _shards[shard].tables.begin(); it != _shards[shard].tables.end(); it++)
+        {
+            for (int i = 0; i < it->second->directory.size(); i++)
+            {
+                delete[] it->second->directory[i];
+            }
+            delete it->second;
+        }
+    }
+    std::map<std::string, SharedSegment*>::iterator it;
+    for (it = _segments.begin(); it != _segments.end(); it++)
+    {
+        delete it->second;
+    }
+    delete _tlb;
+    delete _policy;
+    delete _swap;
 }
 
-std::vector<std::string> PageTable::sortedKeys()
+std::vector<uint32_t> PageTable::sortedPIDs()
 {
-    std::vector<std::string> keys;
+    std::vector<uint32_t> pids;
 
-    std::map<std::string, int>::iterator it;
-    for (it = _table.begin(); it != _table.end(); it++)
+    for (int shard = 0; shard < PAGE_TABLE_SHARDS; shard++)
     {
-        keys.push_back(it->first);
+        std::lock_guard<std::mutex> guard(_shards[shard].lock);
+        std::unordered_map<uint32_t, ProcessPageTable*>::iterator it;
+        for (it = _shards[shard].tables.begin(); it != _shards[shard].tables.end(); it++)
+        {
+            pids.push_back(it->first);
+        }
     }
 
-    std::sort(keys.begin(), keys.end(), PageTableKeyComparator());
+    std::sort(pids.begin(), pids.end());
 
-    return keys;
+    return pids;
 }
 
-void PageTable::addEntry(uint32_t pid, int page_number)
+int PageTable::addEntry(uint32_t pid, int page_number)
 {
-    // Combination of pid and page number act as the key to look up frame number
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
 
-    int frame = 0; 
-    // Find free frame
-    // check each frame, if frame is already assigned, increment frame and try again
-    std::map<std::string,int>::iterator it = _table.begin();
-    while(it != _table.end()) {
-        if(it->second == frame) {
-            frame++;
-            it = _table.begin();
-        } else {
-            it++;
-        }
+    // Already mapped, make sure it is in memory
+    PageTableEntry *existing = getEntry(pid, page_number);
+    if (existing != NULL)
+    {
+        return existing->frame != -1 ? existing->frame : loadPage(pid, page_number, existing);
     }
-    _table[entry] = frame;
-}
 
-int PageTable::getPhysicalAddress(uint32_t pid, uint32_t virtual_address)
-{
-    // Convert virtual address to page_number and page_offset
-    int offset_size = (int)log2((double)_page_size);
-    int page_number = (virtual_address >> offset_size);
-    int page_offset = ((0xFFFFFFFF >> offset_size) & virtual_address);
-    
+    // Find free frame, fail if physical memory is full and no page can be evicted
+    int frame = obtainFrame();
+    if (frame == -1)
+    {
+        return -1;
+    }
+
+    // Changes to the table's shape are made under the shard lock so they never race with a thread printing the table
+    PageTableShard& shard = getShard(pid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    PageTableEntry *entry = createEntry(pid, page_number);
 
-    // Combination of pid and page number act as the key to look up frame number
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    
-    // If entry exists, look up frame number and convert virtual to physical address
-    int address = -1;
-    if (_table.count(entry) > 0)
+    // With demand paging a frame may have held another process' page, start the new page out empty
+    if (_policy != NULL)
     {
-        address = (_table[entry] * _page_size) + page_offset;
+        memset((char*)_memory + (size_t)frame * _page_size, 0, _page_size);
     }
+    entry->frame = frame;
+    placePage(pid, page_number, frame);
+    return frame;
+}
 
-    return address;
+int64_t PageTable::getPhysicalAddress(uint32_t pid, uint32_t virtual_address)
+{
+    return getPhysicalAddress(pid, virtual_address, false);
 }
 
 void PageTable::print()
 {
-    int i;
+    int i, j;
 
-    std::cout << " PID  | Page Number | Frame Number" << std::endl;
-    std::cout << "------+-------------+--------------" << std::endl;
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
 
-    std::vector<std::string> keys = sortedKeys();
+    printf(" PID  | Page Number | Frame Number\n");
+    printf("------+-------------+--------------\n");
 
-    std::string s, pid, page_n;
-    int delim_pos, frame_n;
+    std::vector<uint32_t> pids = sortedPIDs();
 
-    for (i = 0; i < keys.size(); i++)
+    for (i = 0; i < pids.size(); i++)
     {
-        // get pid and page number from string
-        s = keys[i];
-        delim_pos = s.find("|");
-        pid = s.substr(0, delim_pos);
-        page_n = s.substr(delim_pos + 1, s.length() - 1);
-        frame_n = _table[keys[i]];
-        printf("%6s|%13s|%14d\n", pid.c_str(), page_n.c_str(), frame_n);
+        // Hold the shard so the process cannot map or unmap pages while they are listed
+        std::lock_guard<std::mutex> guard(getShard(pids[i]).lock);
+        ProcessPageTable *table = findTable(pids[i]);
+        std::vector<int> pages = findPages(table);
+        for (j = 0; j < pages.size(); j++)
+        {
+            int frame = findEntry(table, pages[j])->frame;
+            if (frame != -1)
+            {
+                printf("%6u|%13d|%14d\n", pids[i], pages[j], frame);
+            }
+            else
+            {
+                printf("%6u|%13d|%14s\n", pids[i], pages[j], "swapped");
+            }
+        }
     }
 }
 
@@ -96,28 +140,385 @@ void PageTable::print()
 // ------------------------------------------------CUSTOM FUNCTIONS------------------------------------------------ //
 // ---------------------------------------------------------------------------------------------------------------- //
 
+/** Translates a virtual address, faulting the page back in from swap if it was evicted
+ * @param pid ID of process.
+ * @param virtual_address Virtual address to translate.
+ * @param write True if the caller is going to write through the address, which marks the page dirty.
+ * @return The physical address, or -1 if the page is not mapped (or cannot be brought back into memory).
+ */
+int64_t PageTable::getPhysicalAddress(uint32_t pid, uint32_t virtual_address, bool write)
+{
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    STATS(_translations.add());
+
+    // Convert virtual address to page_number and page_offset
+    int page_number = (virtual_address >> _offset_size);
+    int page_offset = ((uint32_t)(_page_size - 1) & virtual_address);
+
+    // Check the TLB before walking the table
+    int frame = -1;
+    if (_tlb != NULL)
+    {
+        frame = _tlb->lookup(pid, page_number);
+    }
+
+    // On a miss, look up frame number in the table (loading the page if needed) and cache it
+    if (frame == -1)
+    {
+        PageTableEntry *entry = getEntry(pid, page_number);
+        if (entry == NULL)
+        {
+            STATS(_translation_faults.add());
+            return -1;
+        }
+        frame = entry->frame;
+        if (frame == -1)
+        {
+            frame = loadPage(pid, page_number, entry);
+            if (frame == -1)
+            {
+                STATS(_translation_faults.add());
+                return -1;
+            }
+        }
+        if (_tlb != NULL)
+        {
+            _tlb->insert(pid, page_number, frame);
+        }
+    }
+
+    // A write to a frame shared with a forked process gets its own copy first
+    if (write && _num_shared > 0)
+    {
+        frame = copyOnWrite(pid, page_number, frame);
+        if (frame == -1)
+        {
+            STATS(_translation_faults.add());
+            return -1;
+        }
+    }
+
+    if (_policy != NULL)
+    {
+        _policy->frameAccessed(frame);
+    }
+    if (write)
+    {
+        _frame_dirty[frame] = 1;
+    }
+
+    // Convert virtual to physical address
+    return ((int64_t)frame * _page_size) + page_offset;
+}
+
+/** Gets the shard holding a process' page table
+ * @param pid ID of process.
+ * @return The shard the PID maps to.
+ */
+PageTableShard& PageTable::getShard(uint32_t pid)
+{
+    return _shards[pid % PAGE_TABLE_SHARDS];
+}
+
+/** Gets the page table of a single process
+ * @param pid ID of process.
+ * @return Pointer to the process' page table, or NULL if the process has no pages.
+ */
+ProcessPageTable* PageTable::getProcessTable(uint32_t pid)
+{
+    std::lock_guard<std::mutex> guard(getShard(pid).lock);
+    return findTable(pid);
+}
+
+/** Gets the page table of a single process. The caller must hold the process' shard lock.
+ * @param pid ID of process.
+ * @return Pointer to the process' page table, or NULL if the process has no pages.
+ */
+ProcessPageTable* PageTable::findTable(uint32_t pid)
+{
+    PageTableShard& shard = getShard(pid);
+    std::unordered_map<uint32_t, ProcessPageTable*>::iterator it = shard.tables.find(pid);
+    if (it == shard.tables.end())
+    {
+        return NULL;
+    }
+    return it->second;
+}
+
+/** Gets the entry for a page of a process
+ * @param pid ID of process.
+ * @param page_number Page to look up.
+ * @return Pointer to the page's entry, or NULL if the page is not mapped.
+ */
+PageTableEntry* PageTable::getEntry(uint32_t pid, int page_number)
+{
+    return findEntry(getProcessTable(pid), page_number);
+}
+
+/** Gets the entry for a page in a process' table
+ * @param table The process' page table, may be NULL.
+ * @param page_number Page to look up.
+ * @return Pointer to the page's entry, or NULL if the page is not mapped.
+ */
+PageTableEntry* PageTable::findEntry(ProcessPageTable *table, int page_number)
+{
+    uint32_t dir_index = (uint32_t)page_number >> PAGE_TABLE_LEAF_BITS;
+    if (table == NULL || dir_index >= table->directory.size() || table->directory[dir_index] == NULL)
+    {
+        return NULL;
+    }
+
+    PageTableEntry *entry = &table->directory[dir_index][page_number & PAGE_TABLE_LEAF_MASK];
+    if (!entry->mapped)
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+/** Creates an unmapped-frame entry for a page, creating the process' table and the page's leaf if needed. The caller
+ *  must hold the process' shard lock and set the entry's frame.
+ * @param pid ID of process.
+ * @param page_number Page to create the entry for.
+ * @return The new entry.
+ */
+PageTableEntry* PageTable::createEntry(uint32_t pid, int page_number)
+{
+    // Find the process' table, creating it on its first page
+    PageTableShard& shard = getShard(pid);
+    ProcessPageTable *table;
+    std::unordered_map<uint32_t, ProcessPageTable*>::iterator it = shard.tables.find(pid);
+    if (it != shard.tables.end())
+    {
+        table = it->second;
+    }
+    else
+    {
+        table = new ProcessPageTable();
+        table->num_entries = 0;
+        shard.tables[pid] = table;
+    }
+
+    // Create the leaf that holds this page if it doesn't exist yet
+    uint32_t dir_index = (uint32_t)page_number >> PAGE_TABLE_LEAF_BITS;
+    if (dir_index >= table->directory.size())
+    {
+        table->directory.resize(dir_index + 1, NULL);
+    }
+    if (table->directory[dir_index] == NULL)
+    {
+        PageTableEntry unmapped = {false, -1, -1, false};
+        table->directory[dir_index] = new PageTableEntry[PAGE_TABLE_LEAF_SIZE];
+        std::fill(table->directory[dir_index], table->directory[dir_index] + PAGE_TABLE_LEAF_SIZE, unmapped);
+    }
+
+    PageTableEntry *entry = &table->directory[dir_index][page_number & PAGE_TABLE_LEAF_MASK];
+    entry->mapped = true;
+    entry->frame = -1;
+    entry->swap_slot = -1;
+    entry->shared = false;
+    table->num_entries++;
+    return entry;
+}
+
+/** Gets a free frame, evicting a page when demand paging is enabled and physical memory is full
+ * @return Frame number, or -1 if no frame is available.
+ */
+int PageTable::obtainFrame()
+{
+    int frame = _frames.allocate();
+    if (frame == -1 && _policy != NULL)
+    {
+        frame = evictFrame();
+    }
+    if (frame == -1)
+    {
+        STATS(_frame_failures.add());
+    }
+    return frame;
+}
+
+/** Evicts the page chosen by the replacement policy, writing it to swap if it changed since it was loaded
+ * @return The emptied frame (still marked allocated), or -1 if no frame could be evicted.
+ */
+int PageTable::evictFrame()
+{
+    int victim = _policy->selectVictim();
+    if (victim == -1)
+    {
+        return -1;
+    }
+    if (_num_shared > 0 && isShared(victim))
+    {
+        return evictSharedFrame(victim) ? victim : -1;
+    }
+
+    FrameOwner owner = _frame_owners[victim];
+    PageTableEntry *entry = getEntry(owner.pid, owner.page_number);
+
+    // Clean pages already match their swap copy (or were never written), only dirty pages are written back
+    if (_frame_dirty[victim])
+    {
+        if (entry->swap_slot == -1)
+        {
+            entry->swap_slot = _swap->allocateSlot();
+        }
+        if (!_swap->writePage(entry->swap_slot, (char*)_memory + (size_t)victim * _page_size))
+        {
+            return -1;
+        }
+        _writebacks++;
+    }
+
+    entry->frame = -1;
+    if (_tlb != NULL)
+    {
+        _tlb->invalidate(owner.pid, owner.page_number);
+    }
+    _policy->frameReleased(victim);
+    _evictions++;
+    return victim;
+}
+
+/** Evicts a frame shared by forked pages. Every page mapping it gets its own swap copy, so each is faulted back into
+ *  a frame of its own; nothing changes unless every copy is written.
+ * @param victim The frame.
+ * @return True if the frame was emptied. False if a copy could not be written.
+ */
+bool PageTable::evictSharedFrame(int victim)
+{
+    // The share lock is never held while taking a shard lock, so the sharers are copied out first
+    std::vector<FrameOwner> sharers;
+    {
+        std::lock_guard<std::mutex> guard(_share_lock);
+        sharers = _shared_frames[victim];
+    }
+
+    const char *data = (char*)_memory + (size_t)victim * _page_size;
+    std::vector<PageTableEntry*> entries;
+    std::vector<int> slots;
+    bool written = true;
+    for (int i = 0; i < sharers.size() && written; i++)
+    {
+        PageTableEntry *entry = getEntry(sharers[i].pid, sharers[i].page_number);
+        int slot = (entry->swap_slot != -1) ? entry->swap_slot : _swap->allocateSlot();
+        entries.push_back(entry);
+        slots.push_back(slot);
+        written = _swap->writePage(slot, data);
+    }
+    if (!written)
+    {
+        for (int i = 0; i < entries.size(); i++)
+        {
+            if (entries[i]->swap_slot == -1)
+            {
+                _swap->releaseSlot(slots[i]);
+            }
+        }
+        return false;
+    }
+
+    for (int i = 0; i < entries.size(); i++)
+    {
+        entries[i]->frame = -1;
+        entries[i]->swap_slot = slots[i];
+        if (_tlb != NULL)
+        {
+            _tlb->invalidate(sharers[i].pid, sharers[i].page_number);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(_share_lock);
+        _shared_frames.erase(victim);
+        _num_shared--;
+    }
+    _writebacks += entries.size();
+    _policy->frameReleased(victim);
+    _evictions++;
+    return true;
+}
+
+/** Brings a swapped out page back into a frame (page fault)
+ * @param pid ID of the process the page belongs to.
+ * @param page_number The page to load.
+ * @param entry The page's entry.
+ * @return The frame now holding the page, or -1 if no frame could be freed.
+ */
+int PageTable::loadPage(uint32_t pid, int page_number, PageTableEntry *entry)
+{
+    int frame = obtainFrame();
+    if (frame == -1)
+    {
+        return -1;
+    }
+    _page_faults++;
+
+    // A page with no swap copy was never written before it was evicted
+    char *frame_data = (char*)_memory + (size_t)frame * _page_size;
+    if (entry->swap_slot == -1 || !_swap->readPage(entry->swap_slot, frame_data))
+    {
+        memset(frame_data, 0, _page_size);
+    }
+
+    entry->frame = frame;
+    placePage(pid, page_number, frame);
+    return frame;
+}
+
+/** Records a page as the clean occupant of a frame
+ * @param pid ID of the process the page belongs to.
+ * @param page_number The page.
+ * @param frame The frame now holding the page.
+ */
+void PageTable::placePage(uint32_t pid, int page_number, int frame)
+{
+    _frame_owners[frame].pid = pid;
+    _frame_owners[frame].page_number = page_number;
+    _frame_dirty[frame] = 0;
+    if (_policy != NULL)
+    {
+        _policy->frameLoaded(frame);
+    }
+}
+
 /** Gets all the pages for a given PID
  * @param pid ID of process.
- * @return Vector of all the entries associated with the provided process.
+ * @return Vector of all the page numbers mapped for the provided process, in ascending order.
  */
-std::vector<std::string> PageTable::getAllPagesForPID(uint32_t pid) 
+std::vector<int> PageTable::getAllPagesForPID(uint32_t pid)
 {
-    std::vector<std::string> keys = sortedKeys();
-    std::vector<std::string> entries;
-    std::string s;
-    int i, entry_pid;
+    return findPages(getProcessTable(pid));
+}
 
-    for (i = 0; i < keys.size(); i++)
+/** Gets all the pages mapped in a process' table
+ * @param table The process' page table, may be NULL.
+ * @return Vector of all the page numbers mapped in the table, in ascending order.
+ */
+std::vector<int> PageTable::findPages(ProcessPageTable *table)
+{
+    std::vector<int> pages;
+    if (table == NULL)
     {
-        s = keys[i];
-        entry_pid = stoi(s.substr(0, s.find("|")));
-        if(entry_pid == pid)
+        return pages;
+    }
+
+    for (int i = 0; i < table->directory.size(); i++)
+    {
+        PageTableEntry *leaf = table->directory[i];
+        if (leaf == NULL)
         {
-            entries.push_back(keys[i]);
+            continue;
+        }
+        for (int j = 0; j < PAGE_TABLE_LEAF_SIZE; j++)
+        {
+            if (leaf[j].mapped)
+            {
+                pages.push_back((i << PAGE_TABLE_LEAF_BITS) | j);
+            }
         }
     }
 
-    return entries;
+    return pages;
 }
 
 /** Gets the size of the page
@@ -131,7 +532,86 @@ int PageTable::getPageSize() {
  * @return Size of offset in bytes.
  */
 int PageTable::getOffsetSize() {
-    return (int)log2((double)_page_size);
+    return _offset_size;
+}
+
+/** Gets the physical frame allocator backing the table.
+ * @return Pointer to the frame allocator.
+ */
+FrameAllocator* PageTable::getFrameAllocator() {
+    return &_frames;
+}
+
+/** Puts a TLB in front of address translation, replacing any existing one.
+ * @param num_entries Total number of TLB entries.
+ * @param ways Associativity of the TLB (entries per set). 0 for fully associative.
+ * @param replacement Replacement policy used when a set is full.
+ * @param tag_pids True to tag entries with PIDs, false to flush the TLB whenever the translating PID changes.
+ */
+void PageTable::enableTlb(uint32_t num_entries, uint32_t ways, TlbReplacement replacement, bool tag_pids) {
+    delete _tlb;
+    _tlb = new Tlb(num_entries, ways, replacement, tag_pids);
+}
+
+/** Gets the TLB in front of the table.
+ * @return Pointer to the TLB, or NULL if no TLB is enabled.
+ */
+Tlb* PageTable::getTlb() {
+    return _tlb;
+}
+
+/** Lets pages be evicted to a swap file when physical memory is full. Must be called before any page is mapped.
+ * @param memory Pointer to physical memory, used to copy pages to and from swap.
+ * @param policy_name Replacement policy: "fifo", "lru", "clock" or "second-chance".
+ * @param swap_path Path of the swap file to create.
+ * @return True if demand paging is enabled. False if the policy is unknown or the swap file cannot be created.
+ */
+bool PageTable::enableDemandPaging(void *memory, const std::string& policy_name, const std::string& swap_path) {
+    ReplacementPolicy *policy = ReplacementPolicy::create(policy_name, _frames.getNumFrames());
+    if(policy == NULL) {
+        return false;
+    }
+    SwapFile *swap = new SwapFile(_page_size);
+    if(!swap->open(swap_path)) {
+        delete policy;
+        delete swap;
+        return false;
+    }
+
+    delete _policy;
+    delete _swap;
+    _memory = memory;
+    _policy = policy;
+    _swap = swap;
+    return true;
+}
+
+/** Prints demand paging counters.
+ */
+void PageTable::printPagingStats() {
+    if(_policy == NULL) {
+        printf("Demand paging: disabled\n");
+        return;
+    }
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    printf("Demand paging: %s replacement, %u frames\n", _policy->getName(), _frames.getNumFrames());
+    printf("  frames in use: %u\n", _frames.getNumFrames() - _frames.getNumFree());
+    printf("  page faults:   %llu\n", (unsigned long long)_page_faults);
+    printf("  evictions:     %llu\n", (unsigned long long)_evictions);
+    printf("  write-backs:   %llu\n", (unsigned long long)_writebacks);
+    printf("  swap slots:    %u\n", _swap->getSlotsInUse());
+}
+
+/** Takes the pager lock when demand paging is enabled. Callers that copy data through a translated address hold it
+ *  until the copy is done, so the frame cannot be evicted underneath them. Without demand paging frames never move and
+ *  nothing is locked.
+ * @return The lock, which is released when it goes out of scope.
+ */
+std::unique_lock<std::recursive_mutex> PageTable::lockPager() {
+    if(_policy == NULL) {
+        return std::unique_lock<std::recursive_mutex>(_pager_lock, std::defer_lock);
+    }
+    return std::unique_lock<std::recursive_mutex>(_pager_lock);
 }
 
 /** Checks the table to see if the page exists for the given PID
@@ -140,29 +620,741 @@ int PageTable::getOffsetSize() {
  * @return True if the page exists for that process. False otherwise.
  */
 bool PageTable::entryExists(uint32_t pid, int page_number) {
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    if(_table.count(entry) > 0) {
-        return true;
-    }
-    return false;
+    return getEntry(pid, page_number) != NULL;
 }
 
-/** Removes an entry from the page table
+/** Removes an entry from the page table, releasing its frame and swap slot
  * @param pid ID of process to remove entry from
  * @param page_number Page number to remove.
  */
 void PageTable::removeEntry(uint32_t pid, int page_number) {
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    if(_table.count(entry) > 0) {
-        _table.erase(entry);
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    PageTableShard& shard = getShard(pid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    ProcessPageTable *table = findTable(pid);
+    PageTableEntry *entry = findEntry(table, page_number);
+    if(entry == NULL) {
+        return;
+    }
+
+    // A shared frame stays with the pages still mapping it, a segment's frame with the segment
+    if(entry->frame != -1) {
+        if(!entry->shared && !unshareFrame(entry->frame, pid, page_number)) {
+            _frames.release(entry->frame);
+            if(_policy != NULL) {
+                _policy->frameReleased(entry->frame);
+            }
+        }
+        if(_tlb != NULL) {
+            _tlb->invalidate(pid, page_number);
+        }
+    }
+    if(entry->swap_slot != -1) {
+        _swap->releaseSlot(entry->swap_slot);
+    }
+    entry->mapped = false;
+    entry->frame = -1;
+    entry->swap_slot = -1;
+    entry->shared = false;
+
+    // Release the process' table once its last page is gone
+    table->num_entries--;
+    if(table->num_entries == 0) {
+        for(int i = 0; i < table->directory.size(); i++) {
+            delete[] table->directory[i];
+        }
+        delete table;
+        shard.tables.erase(pid);
+    }
+}
+
+/** Moves a process' resident pages down into the lowest free frames, in page order, so its pages end up in
+ *  contiguous frames once the frames below them are free
+ * @param pid ID of the process.
+ * @param memory Base of physical memory, for copying the pages.
+ * @return Number of pages moved to a new frame.
+ */
+int PageTable::compactFrames(uint32_t pid, void *memory) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    PageTableShard& shard = getShard(pid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    ProcessPageTable *table = findTable(pid);
+    std::vector<int> pages = findPages(table);
+    int moved = 0;
+    for(int i = 0; i < pages.size(); i++) {
+        PageTableEntry *entry = findEntry(table, pages[i]);
+        if(entry->frame == -1 || entry->shared || isShared(entry->frame)) {
+            continue;
+        }
+
+        // The allocator hands out the lowest free frame, only take it if it is below the page's current one
+        int frame = _frames.allocate();
+        if(frame == -1) {
+            break;
+        }
+        if(frame > entry->frame) {
+            _frames.release(frame);
+            continue;
+        }
+
+        int old_frame = entry->frame;
+        memcpy((char*)memory + (size_t)frame * _page_size, (char*)memory + (size_t)old_frame * _page_size, _page_size);
+        _frame_owners[frame] = _frame_owners[old_frame];
+        _frame_dirty[frame] = _frame_dirty[old_frame];
+        if(_policy != NULL) {
+            _policy->frameReleased(old_frame);
+            _policy->frameLoaded(frame);
+        }
+        if(_tlb != NULL) {
+            _tlb->invalidate(pid, pages[i]);
+        }
+        _frames.release(old_frame);
+        entry->frame = frame;
+        moved++;
     }
+    return moved;
+}
+
+/** Sets the base of physical memory, which copy on write copies frames in
+ * @param memory Base of physical memory.
+ */
+void PageTable::setMemory(void *memory) {
+    _memory = memory;
+}
+
+/** Maps every page of a process into a new process as well. Resident pages share the parent's frame until either
+ *  side writes to them; swapped out pages get their own copy of the swap slot.
+ * @param parent_pid ID of the process to copy.
+ * @param child_pid ID of the new process, which must have no pages yet.
+ * @return True if every page was mapped. False if a swap slot could not be copied.
+ */
+bool PageTable::forkEntries(uint32_t parent_pid, uint32_t child_pid) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+
+    std::vector<int> pages;
+    std::vector<PageTableEntry> entries;
+    {
+        std::lock_guard<std::mutex> guard(getShard(parent_pid).lock);
+        ProcessPageTable *table = findTable(parent_pid);
+        pages = findPages(table);
+        for(int i = 0; i < pages.size(); i++) {
+            entries.push_back(*findEntry(table, pages[i]));
+        }
+    }
+
+    std::vector<char> page_data;
+    for(int i = 0; i < pages.size(); i++) {
+        int swap_slot = -1;
+        if(entries[i].shared) {
+            // Segments stay shared, the child is attached below
+        } else if(entries[i].frame != -1) {
+            std::lock_guard<std::mutex> guard(_share_lock);
+            std::vector<FrameOwner>& sharers = _shared_frames[entries[i].frame];
+            if(sharers.empty()) {
+                sharers.push_back(_frame_owners[entries[i].frame]);
+                _num_shared++;
+            }
+            FrameOwner child = {child_pid, pages[i]};
+            sharers.push_back(child);
+            // Whichever page ends up owning the frame must write it back, its swap slot (if any) is not the child's
+            _frame_dirty[entries[i].frame] = 1;
+        } else if(entries[i].swap_slot != -1) {
+            page_data.resize(_page_size);
+            swap_slot = _swap->allocateSlot();
+            if(!_swap->readPage(entries[i].swap_slot, page_data.data()) || !_swap->writePage(swap_slot, page_data.data())) {
+                _swap->releaseSlot(swap_slot);
+                return false;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(getShard(child_pid).lock);
+        PageTableEntry *entry = createEntry(child_pid, pages[i]);
+        entry->frame = entries[i].frame;
+        entry->swap_slot = swap_slot;
+        entry->shared = entries[i].shared;
+    }
+
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    std::map<std::string, SharedSegment*>::iterator it;
+    for(it = _segments.begin(); it != _segments.end(); it++) {
+        if(it->second->attached.count(parent_pid) != 0) {
+            it->second->attached.insert(child_pid);
+        }
+    }
+    return true;
+}
+
+/** Gets the number of frames shared between forked processes
+ * @return Number of shared frames.
+ */
+uint32_t PageTable::getNumSharedFrames() {
+    return _num_shared;
+}
+
+/** Checks if a frame is shared between forked processes
+ * @param frame Frame to check.
+ * @return True if more than one page maps the frame.
+ */
+bool PageTable::isShared(int frame) {
+    std::lock_guard<std::mutex> guard(_share_lock);
+    return _shared_frames.count(frame) != 0;
+}
+
+/** Stops a page from sharing a frame. Once a single page is left mapping the frame, it becomes that page's own frame
+ *  again.
+ * @param frame Frame the page maps.
+ * @param pid ID of the process the page belongs to.
+ * @param page_number The page.
+ * @return True if other pages still map the frame. False if the frame was not shared.
+ */
+bool PageTable::unshareFrame(int frame, uint32_t pid, int page_number) {
+    std::lock_guard<std::mutex> guard(_share_lock);
+    std::unordered_map<int, std::vector<FrameOwner> >::iterator it = _shared_frames.find(frame);
+    if(it == _shared_frames.end()) {
+        return false;
+    }
+
+    std::vector<FrameOwner>& sharers = it->second;
+    for(int i = 0; i < sharers.size(); i++) {
+        if(sharers[i].pid == pid && sharers[i].page_number == page_number) {
+            sharers[i] = sharers.back();
+            sharers.pop_back();
+            break;
+        }
+    }
+    if(sharers.size() == 1) {
+        _frame_owners[frame] = sharers[0];
+        _shared_frames.erase(it);
+        _num_shared--;
+    }
+    return true;
+}
+
+/** Gives a page its own copy of a shared frame before it is written
+ * @param pid ID of the process writing.
+ * @param page_number The page being written.
+ * @param frame Frame the page maps now.
+ * @return The frame to write to: the same frame if it is not shared, otherwise the copy. -1 if no frame is free.
+ */
+int PageTable::copyOnWrite(uint32_t pid, int page_number, int frame) {
+    if(!isShared(frame)) {
+        return frame;
+    }
+
+    // The entry is looked up before taking the share lock, the lock is never held while waiting for a shard
+    PageTableEntry *entry = getEntry(pid, page_number);
+
+    // The frame being copied is taken out of the policy meanwhile, so making room for the copy cannot evict it
+    if(_policy != NULL) {
+        _policy->frameReleased(frame);
+    }
+    int copy = obtainFrame();
+    if(_policy != NULL) {
+        _policy->frameLoaded(frame);
+    }
+    if(copy == -1) {
+        return -1;
+    }
+    memcpy((char*)_memory + (size_t)copy * _page_size, (char*)_memory + (size_t)frame * _page_size, _page_size);
+
+    // The other pages may have stopped sharing in the meantime, leaving this page the frame's only user
+    if(!unshareFrame(frame, pid, page_number)) {
+        _frames.release(copy);
+        return frame;
+    }
+    entry->frame = copy;
+    placePage(pid, page_number, copy);
+    if(_tlb != NULL) {
+        _tlb->invalidate(pid, page_number);
+        _tlb->insert(pid, page_number, copy);
+    }
+    return copy;
+}
+
+/** Creates a shared memory segment, taking its frames right away
+ * @param name Name of the segment.
+ * @param size Size of the segment in bytes, rounded up to whole pages.
+ * @return True if the segment was created. False if the name is taken or there are not enough frames.
+ */
+bool PageTable::createSegment(const std::string& name, uint32_t size) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    // Counted in 64 bits so a size near UINT32_MAX does not wrap around to a segment with no pages, and rejected
+    // when it needs more frames than there are or its rounded up size no longer fits in 32 bits
+    uint64_t num_pages = ((uint64_t)size + _page_size - 1) / _page_size;
+    if(size == 0 || num_pages > _frames.getNumFrames() || num_pages * _page_size > UINT32_MAX ||
+       _segments.count(name) != 0) {
+        return false;
+    }
+
+    SharedSegment *segment = new SharedSegment();
+    segment->size = num_pages * _page_size;
+    segment->destroyed = false;
+    for(uint32_t i = 0; i < num_pages; i++) {
+        int frame = obtainFrame();
+        if(frame == -1) {
+            for(int j = 0; j < segment->frames.size(); j++) {
+                _frames.release(segment->frames[j]);
+            }
+            delete segment;
+            return false;
+        }
+        // Segment frames are never handed to the replacement policy, so they are never evicted
+        memset((char*)_memory + (size_t)frame * _page_size, 0, _page_size);
+        segment->frames.push_back(frame);
+    }
+    _segments[name] = segment;
+    return true;
+}
+
+/** Destroys a shared memory segment. Processes attached to it keep it until they detach, no process can attach to it
+ *  any more, and its name stays taken until it is freed.
+ * @param name Name of the segment.
+ * @return True if the segment existed. False otherwise.
+ */
+bool PageTable::destroySegment(const std::string& name) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    if(it == _segments.end() || it->second->destroyed) {
+        return false;
+    }
+    it->second->destroyed = true;
+    if(it->second->attached.empty()) {
+        freeSegment(it);
+    }
+    return true;
+}
+
+/** Gets the size of a shared memory segment
+ * @param name Name of the segment.
+ * @return Size in bytes, 0 if there is no such segment or it was destroyed.
+ */
+uint32_t PageTable::getSegmentSize(const std::string& name) {
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    return (it == _segments.end() || it->second->destroyed) ? 0 : it->second->size;
 }
 
-/** Removes an entry from the page table
- * @param entry Entry key to try to remove from the table
+/** Maps a shared memory segment into a process
+ * @param pid ID of the process.
+ * @param name Name of the segment.
+ * @param virtual_address Page aligned address to map the segment at, the range must not hold any variable.
+ * @return True if the segment was mapped. False if there is no such segment or the process is already attached.
  */
-void PageTable::removeEntry(std::string entry) {
-    if(_table.count(entry) > 0) {
-        _table.erase(entry);
+bool PageTable::attachSegment(uint32_t pid, const std::string& name, uint32_t virtual_address) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    std::lock_guard<std::mutex> segment_guard(_segment_lock);
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    if(it == _segments.end() || it->second->destroyed || it->second->attached.count(pid) != 0) {
+        return false;
     }
-}
\ No newline at end of file
+
+    SharedSegment *segment = it->second;
+    int first_page = virtual_address >> _offset_size;
+    for(int i = 0; i < segment->frames.size(); i++) {
+        // A variable ending right where the segment starts maps the page after it, no data lives there
+        if(getEntry(pid, first_page + i) != NULL) {
+            removeEntry(pid, first_page + i);
+        }
+        std::lock_guard<std::mutex> guard(getShard(pid).lock);
+        PageTableEntry *entry = createEntry(pid, first_page + i);
+        entry->frame = segment->frames[i];
+        entry->shared = true;
+    }
+    segment->attached.insert(pid);
+    return true;
+}
+
+/** Unmaps a shared memory segment from a process, freeing the segment if it was destroyed and this was its last process
+ * @param pid ID of the process.
+ * @param name Name of the segment.
+ * @param virtual_address Address the segment is mapped at in the process.
+ * @return True if the segment was unmapped. False if the process is not attached to it.
+ */
+bool PageTable::detachSegment(uint32_t pid, const std::string& name, uint32_t virtual_address) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    if(it == _segments.end() || it->second->attached.erase(pid) == 0) {
+        return false;
+    }
+
+    int first_page = virtual_address >> _offset_size;
+    for(int i = 0; i < it->second->frames.size(); i++) {
+        removeEntry(pid, first_page + i);
+    }
+    if(it->second->destroyed && it->second->attached.empty()) {
+        freeSegment(it);
+    }
+    return true;
+}
+
+/** Drops every segment attachment of a process that is terminating. The caller removes the process' pages first.
+ * @param pid ID of the process.
+ */
+void PageTable::detachAllSegments(uint32_t pid) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    std::map<std::string, SharedSegment*>::iterator it = _segments.begin();
+    while(it != _segments.end()) {
+        std::map<std::string, SharedSegment*>::iterator next = it;
+        next++;
+        if(it->second->attached.erase(pid) != 0 && it->second->destroyed && it->second->attached.empty()) {
+            freeSegment(it);
+        }
+        it = next;
+    }
+}
+
+/** Checks if a process is attached to a shared memory segment
+ * @param pid ID of the process.
+ * @param name Name of the segment.
+ * @return True if the segment is mapped into the process.
+ */
+bool PageTable::isAttached(uint32_t pid, const std::string& name) {
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    return it != _segments.end() && it->second->attached.count(pid) != 0;
+}
+
+/** Prints every shared memory segment */
+void PageTable::printSegments() {
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    printf(" Name            | Size       | Frames | Attached PIDs\n");
+    printf("-----------------+------------+--------+---------------\n");
+    std::map<std::string, SharedSegment*>::iterator it;
+    for(it = _segments.begin(); it != _segments.end(); it++) {
+        printf(" %-15s | %10u | %6zu |", it->first.c_str(), it->second->size, it->second->frames.size());
+        std::set<uint32_t>::iterator pid;
+        for(pid = it->second->attached.begin(); pid != it->second->attached.end(); pid++) {
+            printf(" %u", *pid);
+        }
+        printf(it->second->destroyed ? " (destroyed)\n" : "\n");
+    }
+}
+
+/** Frees a segment's frames and the segment. The caller holds the segment lock.
+ * @param it The segment's position in the segment map.
+ */
+void PageTable::freeSegment(std::map<std::string, SharedSegment*>::iterator it) {
+    for(int i = 0; i < it->second->frames.size(); i++) {
+        _frames.release(it->second->frames[i]);
+    }
+    delete it->second;
+    _segments.erase(it);
+}
+
+/** Unmaps every page and frees every segment, swap slot and frame. No other thread may be using the table.
+ */
+void PageTable::clear() {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    for(int shard = 0; shard < PAGE_TABLE_SHARDS; shard++) {
+        std::lock_guard<std::mutex> guard(_shards[shard].lock);
+        std::unordered_map<uint32_t, ProcessPageTable*>::iterator it;
+        for(it = _shards[shard].tables.begin(); it != _shards[shard].tables.end(); it++) {
+            for(int i = 0; i < it->second->directory.size(); i++) {
+                PageTableEntry *leaf = it->second->directory[i];
+                for(int j = 0; leaf != NULL && j < PAGE_TABLE_LEAF_SIZE; j++) {
+                    if(leaf[j].mapped && leaf[j].swap_slot != -1) {
+                        _swap->releaseSlot(leaf[j].swap_slot);
+                    }
+                }
+                delete[] leaf;
+            }
+            delete it->second;
+        }
+        _shards[shard].tables.clear();
+    }
+    {
+        std::lock_guard<std::mutex> guard(_segment_lock);
+        std::map<std::string, SharedSegment*>::iterator it;
+        for(it = _segments.begin(); it != _segments.end(); it++) {
+            delete it->second;
+        }
+        _segments.clear();
+    }
+    {
+        std::lock_guard<std::mutex> guard(_share_lock);
+        _shared_frames.clear();
+        _num_shared = 0;
+    }
+
+    std::vector<int> frames = _frames.getAllocated();
+    for(int i = 0; i < frames.size(); i++) {
+        _frames.release(frames[i]);
+        if(_policy != NULL) {
+            _policy->frameReleased(frames[i]);
+        }
+    }
+    FrameOwner no_owner = {0, -1};
+    std::fill(_frame_owners.begin(), _frame_owners.end(), no_owner);
+    std::fill(_frame_dirty.begin(), _frame_dirty.end(), 0);
+    if(_tlb != NULL) {
+        _tlb->flush();
+    }
+}
+
+/** Writes every page mapping, the frames shared by forked processes and the shared memory segments to a snapshot.
+ *  Swapped out pages are written in full, so the snapshot does not depend on the swap file. No other thread may be
+ *  changing the table.
+ * @param writer Snapshot being written.
+ */
+void PageTable::save(SnapshotWriter& writer) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    std::vector<char> page_data(_page_size);
+
+    std::vector<uint32_t> pids = sortedPIDs();
+    writer.put<uint32_t>(pids.size());
+    for(int i = 0; i < pids.size(); i++) {
+        std::lock_guard<std::mutex> guard(getShard(pids[i]).lock);
+        ProcessPageTable *table = findTable(pids[i]);
+        std::vector<int> pages = findPages(table);
+        writer.put<uint32_t>(pids[i]);
+        writer.put<uint32_t>(pages.size());
+        for(int j = 0; j < pages.size(); j++) {
+            PageTableEntry *entry = findEntry(table, pages[j]);
+            writer.put<int32_t>(pages[j]);
+            writer.put<int32_t>(entry->frame);
+            writer.put<uint8_t>(entry->shared);
+            if(entry->frame != -1) {
+                // The swap copy is not kept, so a resident page that has one must be written back when evicted
+                writer.put<uint8_t>(_frame_dirty[entry->frame] || entry->swap_slot != -1);
+            } else {
+                bool has_copy = entry->swap_slot != -1 && _swap->readPage(entry->swap_slot, page_data.data());
+                writer.put<uint8_t>(has_copy);
+                if(has_copy) {
+                    writer.write(page_data.data(), _page_size);
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(_share_lock);
+        writer.put<uint32_t>(_shared_frames.size());
+        std::unordered_map<int, std::vector<FrameOwner> >::iterator it;
+        for(it = _shared_frames.begin(); it != _shared_frames.end(); it++) {
+            writer.put<int32_t>(it->first);
+            writer.put<uint32_t>(it->second.size());
+            for(int i = 0; i < it->second.size(); i++) {
+                writer.put<uint32_t>(it->second[i].pid);
+                writer.put<int32_t>(it->second[i].page_number);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(_segment_lock);
+    writer.put<uint32_t>(_segments.size());
+    std::map<std::string, SharedSegment*>::iterator it;
+    for(it = _segments.begin(); it != _segments.end(); it++) {
+        SharedSegment *segment = it->second;
+        writer.putString(it->first);
+        writer.put<uint32_t>(segment->size);
+        writer.put<uint8_t>(segment->destroyed);
+        writer.put<uint32_t>(segment->frames.size());
+        for(int i = 0; i < segment->frames.size(); i++) {
+            writer.put<int32_t>(segment->frames[i]);
+        }
+        writer.put<uint32_t>(segment->attached.size());
+        std::set<uint32_t>::iterator pid;
+        for(pid = segment->attached.begin(); pid != segment->attached.end(); pid++) {
+            writer.put<uint32_t>(*pid);
+        }
+    }
+}
+
+/** Replaces every mapping with those written by save, taking the frames they use. Swapped out pages get new slots in
+ *  the swap file, and resident pages are handed to the replacement policy in frame order (its access history is not
+ *  kept). No other thread may be using the table.
+ * @param reader Snapshot being read.
+ * @return True if the table was read. False if the snapshot is truncated or invalid (or holds swapped out pages and
+ *  demand paging is disabled), the table is then left empty.
+ */
+bool PageTable::load(SnapshotReader& reader) {
+    std::unique_lock<std::recursive_mutex> pager = lockPager();
+    clear();
+    int num_frames = _frames.getNumFrames();
+    std::vector<char> page_data(_page_size);
+    std::vector<int> resident;
+
+    uint32_t num_tables = reader.get<uint32_t>();
+    for(uint32_t i = 0; i < num_tables && reader.ok(); i++) {
+        uint32_t pid = reader.get<uint32_t>();
+        uint32_t num_pages = reader.get<uint32_t>();
+        for(uint32_t j = 0; j < num_pages && reader.ok(); j++) {
+            int page_number = reader.get<int32_t>();
+            int frame = reader.get<int32_t>();
+            bool shared = reader.get<uint8_t>() != 0;
+            bool flag = reader.get<uint8_t>() != 0;
+            if(page_number < 0 || frame < -1 || frame >= num_frames || (frame == -1 && shared) ||
+               getEntry(pid, page_number) != NULL) {
+                reader.fail();
+                break;
+            }
+
+            int swap_slot = -1;
+            if(frame == -1 && flag) {
+                reader.read(page_data.data(), _page_size);
+                if(_swap == NULL) {
+                    reader.fail();
+                    break;
+                }
+                swap_slot = _swap->allocateSlot();
+                if(!_swap->writePage(swap_slot, page_data.data())) {
+                    _swap->releaseSlot(swap_slot);
+                    reader.fail();
+                    break;
+                }
+            }
+            // Forked pages and segments map the same frame from several pages, so it may already be taken
+            if(frame != -1) {
+                _frames.reserve(frame);
+            }
+
+            std::lock_guard<std::mutex> guard(getShard(pid).lock);
+            PageTableEntry *entry = createEntry(pid, page_number);
+            entry->frame = frame;
+            entry->swap_slot = swap_slot;
+            entry->shared = shared;
+            if(frame != -1 && !shared) {
+                _frame_owners[frame].pid = pid;
+                _frame_owners[frame].page_number = page_number;
+                _frame_dirty[frame] = flag;
+                resident.push_back(frame);
+            }
+        }
+    }
+
+    uint32_t num_shared = reader.get<uint32_t>();
+    for(uint32_t i = 0; i < num_shared && reader.ok(); i++) {
+        int frame = reader.get<int32_t>();
+        uint32_t num_sharers = reader.get<uint32_t>();
+        if(frame < 0 || frame >= num_frames || num_sharers < 2 || !_frames.isAllocated(frame)) {
+            reader.fail();
+            break;
+        }
+        std::vector<FrameOwner>& sharers = _shared_frames[frame];
+        for(uint32_t j = 0; j < num_sharers && reader.ok(); j++) {
+            FrameOwner owner;
+            owner.pid = reader.get<uint32_t>();
+            owner.page_number = reader.get<int32_t>();
+            // Each sharer must be a distinct private page that maps the frame
+            PageTableEntry *entry = getEntry(owner.pid, owner.page_number);
+            bool listed = false;
+            for(int k = 0; k < sharers.size(); k++) {
+                listed = listed || (sharers[k].pid == owner.pid && sharers[k].page_number == owner.page_number);
+            }
+            if(owner.page_number < 0 || entry == NULL || entry->shared || entry->frame != frame || listed) {
+                reader.fail();
+                break;
+            }
+            sharers.push_back(owner);
+        }
+    }
+    _num_shared = _shared_frames.size();
+
+    // A frame mapped by several private pages must list exactly those pages as its sharers, or a write to one of
+    // them would not be copied and the others would see it
+    std::unordered_map<int, uint32_t> mappings;
+    for(int i = 0; i < resident.size(); i++) {
+        mappings[resident[i]]++;
+    }
+    if(reader.ok()) {
+        for(std::unordered_map<int, uint32_t>::iterator it = mappings.begin(); it != mappings.end(); ++it) {
+            std::unordered_map<int, std::vector<FrameOwner> >::iterator shared = _shared_frames.find(it->first);
+            uint32_t num_sharers = (shared == _shared_frames.end()) ? 1 : shared->second.size();
+            if(it->second != num_sharers) {
+                reader.fail();
+                break;
+            }
+        }
+    }
+
+    uint32_t num_segments = reader.get<uint32_t>();
+    for(uint32_t i = 0; i < num_segments && reader.ok(); i++) {
+        std::string name = reader.getString();
+        SharedSegment *segment = new SharedSegment();
+        segment->size = reader.get<uint32_t>();
+        segment->destroyed = reader.get<uint8_t>() != 0;
+        uint32_t num_segment_frames = reader.get<uint32_t>();
+        if((uint64_t)num_segment_frames * _page_size != segment->size || _segments.count(name) != 0) {
+            reader.fail();
+            delete segment;
+            break;
+        }
+        _segments[name] = segment;
+        for(uint32_t j = 0; j < num_segment_frames && reader.ok(); j++) {
+            int frame = reader.get<int32_t>();
+            // Segment frames are only mapped by segment pages, never by a private page
+            if(frame < 0 || frame >= num_frames || mappings.count(frame) != 0) {
+                reader.fail();
+                break;
+            }
+            _frames.reserve(frame);
+            segment->frames.push_back(frame);
+        }
+        uint32_t num_attached = reader.get<uint32_t>();
+        for(uint32_t j = 0; j < num_attached && reader.ok(); j++) {
+            segment->attached.insert(reader.get<uint32_t>());
+        }
+    }
+
+    if(!reader.ok()) {
+        clear();
+        return false;
+    }
+
+    // Frames shared by forked pages are mapped by several entries, but are only loaded into the policy once
+    if(_policy != NULL) {
+        std::sort(resident.begin(), resident.end());
+        resident.erase(std::unique(resident.begin(), resident.end()), resident.end());
+        for(int i = 0; i < resident.size(); i++) {
+            _policy->frameLoaded(resident[i]);
+        }
+    }
+    return true;
+}
+
+/** Prints translation counts, frames in use and the number of pages each process has mapped */
+void PageTable::printStats() {
+    printf("Translation:\n");
+    printf("  %-22s %llu\n", "translations:", (unsigned long long)_translations.get());
+    printf("  %-22s %llu\n", "faults:", (unsigned long long)_translation_faults.get());
+    printf("Frames:\n");
+    printf("  %-22s %u of %u\n", "in use:", _frames.getNumFrames() - _frames.getNumFree(), _frames.getNumFrames());
+    printf("  %-22s %llu\n", "allocation failures:", (unsigned long long)_frame_failures.get());
+    printf(" PID  | Pages Mapped\n");
+    printf("------+--------------\n");
+    std::vector<uint32_t> pids = sortedPIDs();
+    for(int i = 0; i < pids.size(); i++) {
+        std::lock_guard<std::mutex> guard(getShard(pids[i]).lock);
+        ProcessPageTable *table = findTable(pids[i]);
+        if(table != NULL) {
+            printf("%6u|%14u\n", pids[i], table->num_entries);
+        }
+    }
+}
+
+/** Writes the translation and frame statistics, with the pages mapped by each process, as a JSON object
+ * @param file File to write to.
+ */
+void PageTable::writeStatsJson(FILE *file) {
+    fprintf(file, "{\"translations\": %llu, \"translation_faults\": %llu, \"frames\": %u, \"frames_in_use\": %u, "
+            "\"frame_failures\": %llu, \"pages_mapped\": {", (unsigned long long)_translations.get(),
+            (unsigned long long)_translation_faults.get(), _frames.getNumFrames(),
+            _frames.getNumFrames() - _frames.getNumFree(), (unsigned long long)_frame_failures.get());
+    std::vector<uint32_t> pids = sortedPIDs();
+    bool first = true;
+    for(int i = 0; i < pids.size(); i++) {
+        std::lock_guard<std::mutex> guard(getShard(pids[i]).lock);
+        ProcessPageTable *table = findTable(pids[i]);
+        if(table != NULL) {
+            fprintf(file, "%s\"%u\": %u", first ? "" : ", ", pids[i], table->num_entries);
+            first = false;
+        }
+    }
+    fprintf(file, "}}");
+}
@@ -0,0 +1,104 @@
+#include "physicalmemory.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PhysicalMemory::PhysicalMemory()
+{
+    _data = NULL;
+    _size = 0;
+    _fd = -1;
+}
+
+PhysicalMemory::~PhysicalMemory()
+{
+    if (_data != NULL)
+    {
+        if (_fd != -1)
+        {
+            msync(_data, _size, MS_SYNC);
+        }
+        munmap(_data, _size);
+    }
+    if (_fd != -1)
+    {
+        close(_fd);
+    }
+}
+
+/** Maps the memory. Nothing is committed until a page is first touched.
+ * @param size Size of memory in bytes.
+ * @param path File to back the memory with, created or grown to size bytes if needed. Empty for anonymous memory.
+ * @return True if the memory was mapped. False otherwise.
+ */
+bool PhysicalMemory::map(uint64_t size, const std::string& path)
+{
+    if (path.empty())
+    {
+        _data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    else
+    {
+        // Keep the contents of an existing file, only growing it (sparsely) when it is too small
+        _fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        struct stat file_info;
+        if (_fd == -1 || fstat(_fd, &file_info) == -1)
+        {
+            return false;
+        }
+        if ((uint64_t)file_info.st_size < size && ftruncate(_fd, size) == -1)
+        {
+            return false;
+        }
+        _data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    }
+
+    if (_data == MAP_FAILED)
+    {
+        _data = NULL;
+        return false;
+    }
+    _size = size;
+    return true;
+}
+
+/** Gets the start of memory.
+ * @return Pointer to the first byte of memory, or NULL if it is not mapped.
+ */
+void* PhysicalMemory::getData()
+{
+    return _data;
+}
+
+/** Gets the size of memory.
+ * @return Size of memory in bytes.
+ */
+uint64_t PhysicalMemory::getSize()
+{
+    return _size;
+}
+
+/** Checks if memory is backed by a file.
+ * @return True if the contents are written to a file. False for anonymous memory.
+ */
+bool PhysicalMemory::isPersistent()
+{
+    return _fd != -1;
+}
+
+/** Replaces the contents of anonymous memory with a private copy-on-write mapping of part of a file. Pages are read
+ *  from the file as they are first touched and writes never reach it, so mapping takes the same time however large
+ *  memory is. The file must not be changed while it is mapped.
+ * @param fd Open file to map, at least offset plus the size of memory bytes long.
+ * @param offset Where memory starts in the file, a multiple of the host's page size.
+ * @return True if the file was mapped. False if memory is backed by a file, whose contents must be copied instead.
+ */
+bool PhysicalMemory::mapFile(int fd, uint64_t offset)
+{
+    if (_data == NULL || _fd != -1)
+    {
+        return false;
+    }
+    return mmap(_data, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset) != MAP_FAILED;
+}
@@ -0,0 +1,266 @@
+#include "replacement.h"
+
+/** Creates a replacement policy by name
+ * @param name One of "fifo", "lru", "clock" or "second-chance".
+ * @param num_frames Number of physical frames the policy chooses from.
+ * @return The new policy, or NULL if the name is not recognized.
+ */
+ReplacementPolicy* ReplacementPolicy::create(const std::string& name, uint32_t num_frames)
+{
+    if (name == "fifo")
+    {
+        return new FifoPolicy(num_frames);
+    }
+    else if (name == "lru")
+    {
+        return new LruPolicy(num_frames);
+    }
+    else if (name == "clock")
+    {
+        return new ClockPolicy(num_frames);
+    }
+    else if (name == "second-chance")
+    {
+        return new SecondChancePolicy(num_frames);
+    }
+    return NULL;
+}
+
+
+
+// ---------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------FRAME QUEUE-------------------------------------------------- //
+// ---------------------------------------------------------------------------------------------------------------- //
+
+FrameQueue::FrameQueue(uint32_t num_frames)
+{
+    _prev.resize(num_frames, -1);
+    _next.resize(num_frames, -1);
+    _queued.resize(num_frames, false);
+    _head = -1;
+    _tail = -1;
+}
+
+/** Appends a frame to the back of the queue
+ * @param frame Frame number. Must not already be queued.
+ */
+void FrameQueue::pushBack(int frame)
+{
+    _prev[frame] = _tail;
+    _next[frame] = -1;
+    if (_tail != -1)
+    {
+        _next[_tail] = frame;
+    }
+    else
+    {
+        _head = frame;
+    }
+    _tail = frame;
+    _queued[frame] = true;
+}
+
+/** Unlinks a frame from the queue
+ * @param frame Frame number. Ignored if not queued.
+ */
+void FrameQueue::remove(int frame)
+{
+    if (!_queued[frame])
+    {
+        return;
+    }
+    if (_prev[frame] != -1)
+    {
+        _next[_prev[frame]] = _next[frame];
+    }
+    else
+    {
+        _head = _next[frame];
+    }
+    if (_next[frame] != -1)
+    {
+        _prev[_next[frame]] = _prev[frame];
+    }
+    else
+    {
+        _tail = _prev[frame];
+    }
+    _queued[frame] = false;
+}
+
+/** Gets the frame at the front of the queue
+ * @return Frame number, or -1 if the queue is empty.
+ */
+int FrameQueue::front()
+{
+    return _head;
+}
+
+/** Checks whether a frame is in the queue
+ * @param frame Frame number.
+ * @return True if the frame is queued. False otherwise.
+ */
+bool FrameQueue::contains(int frame)
+{
+    return _queued[frame];
+}
+
+
+
+// ---------------------------------------------------------------------------------------------------------------- //
+// -----------------------------------------------------POLICIES--------------------------------------------------- //
+// ---------------------------------------------------------------------------------------------------------------- //
+
+FifoPolicy::FifoPolicy(uint32_t num_frames) : _queue(num_frames)
+{
+}
+
+void FifoPolicy::frameLoaded(int frame)
+{
+    _queue.remove(frame);
+    _queue.pushBack(frame);
+}
+
+void FifoPolicy::frameAccessed(int frame)
+{
+}
+
+void FifoPolicy::frameReleased(int frame)
+{
+    _queue.remove(frame);
+}
+
+int FifoPolicy::selectVictim()
+{
+    return _queue.front();
+}
+
+const char* FifoPolicy::getName()
+{
+    return "fifo";
+}
+
+LruPolicy::LruPolicy(uint32_t num_frames) : _queue(num_frames)
+{
+}
+
+void LruPolicy::frameLoaded(int frame)
+{
+    _queue.remove(frame);
+    _queue.pushBack(frame);
+}
+
+void LruPolicy::frameAccessed(int frame)
+{
+    // Most recently used frames live at the back
+    if (_queue.contains(frame))
+    {
+        _queue.remove(frame);
+        _queue.pushBack(frame);
+    }
+}
+
+void LruPolicy::frameReleased(int frame)
+{
+    _queue.remove(frame);
+}
+
+int LruPolicy::selectVictim()
+{
+    return _queue.front();
+}
+
+const char* LruPolicy::getName()
+{
+    return "lru";
+}
+
+ClockPolicy::ClockPolicy(uint32_t num_frames)
+{
+    _loaded.resize(num_frames, false);
+    _referenced.resize(num_frames, false);
+    _hand = 0;
+}
+
+void ClockPolicy::frameLoaded(int frame)
+{
+    _loaded[frame] = true;
+    _referenced[frame] = true;
+}
+
+void ClockPolicy::frameAccessed(int frame)
+{
+    _referenced[frame] = true;
+}
+
+void ClockPolicy::frameReleased(int frame)
+{
+    _loaded[frame] = false;
+    _referenced[frame] = false;
+}
+
+int ClockPolicy::selectVictim()
+{
+    // Two full sweeps are enough: the first clears every reference bit
+    for (uint32_t step = 0; step < 2 * _loaded.size(); step++)
+    {
+        uint32_t frame = _hand;
+        _hand = (_hand + 1) % _loaded.size();
+        if (!_loaded[frame])
+        {
+            continue;
+        }
+        if (!_referenced[frame])
+        {
+            return frame;
+        }
+        _referenced[frame] = false;
+    }
+    return -1;
+}
+
+const char* ClockPolicy::getName()
+{
+    return "clock";
+}
+
+SecondChancePolicy::SecondChancePolicy(uint32_t num_frames) : _queue(num_frames)
+{
+    _referenced.resize(num_frames, false);
+}
+
+void SecondChancePolicy::frameLoaded(int frame)
+{
+    _queue.remove(frame);
+    _queue.pushBack(frame);
+    _referenced[frame] = false;
+}
+
+void SecondChancePolicy::frameAccessed(int frame)
+{
+    _referenced[frame] = true;
+}
+
+void SecondChancePolicy::frameReleased(int frame)
+{
+    _queue.remove(frame);
+    _referenced[frame] = false;
+}
+
+int SecondChancePolicy::selectVictim()
+{
+    int frame = _queue.front();
+    while (frame != -1 && _referenced[frame])
+    {
+        _referenced[frame] = false;
+        _queue.remove(frame);
+        _queue.pushBack(frame);
+        frame = _queue.front();
+    }
+    return frame;
+}
+
+const char* SecondChancePolicy::getName()
+{
+    return "second-chance";
+}
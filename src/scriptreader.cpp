@@ -0,0 +1,76 @@
+#include "scriptreader.h"
+#include <cstring>
+
+ScriptReader::ScriptReader()
+{
+    _file = NULL;
+    _position = 0;
+    _end = 0;
+}
+
+ScriptReader::~ScriptReader()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+    }
+}
+
+/** Opens a command file for reading
+ * @param path Path of the file.
+ * @return True if the file was opened. False otherwise.
+ */
+bool ScriptReader::open(const std::string& path)
+{
+    _file = fopen(path.c_str(), "rb");
+    if (_file == NULL)
+    {
+        return false;
+    }
+    _buffer.resize(SCRIPT_READER_BUFFER_SIZE);
+    return true;
+}
+
+/** Reads the next line of the file, without its line ending
+ * @param line Set to the contents of the line.
+ * @return True if a line was read. False at the end of the file.
+ */
+bool ScriptReader::nextLine(std::string& line)
+{
+    line.clear();
+    while (true)
+    {
+        if (_position == _end && !fill())
+        {
+            // A last line without a newline still counts
+            return !line.empty();
+        }
+
+        char *start = &_buffer[_position];
+        char *newline = (char*)memchr(start, '\n', _end - _position);
+        if (newline == NULL)
+        {
+            line.append(start, _end - _position);
+            _position = _end;
+            continue;
+        }
+
+        line.append(start, newline - start);
+        _position += (newline - start) + 1;
+        if (!line.empty() && line[line.size() - 1] == '\r')
+        {
+            line.erase(line.size() - 1);
+        }
+        return true;
+    }
+}
+
+/** Reads the next chunk of the file into the buffer
+ * @return True if any bytes were read. False at the end of the file.
+ */
+bool ScriptReader::fill()
+{
+    _position = 0;
+    _end = fread(&_buffer[0], 1, _buffer.size(), _file);
+    return _end > 0;
+}
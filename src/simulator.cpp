@@ -0,0 +1,597 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include "simulator.h"
+
+uint32_t createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table)
+{
+    //   - create new process in the MMU
+    int pid = mmu->createProcess();
+    //   - allocate new variables for the <TEXT>, <GLOBALS>, and <STACK>
+    allocateVariable(pid, "<TEXT>", Char, text_size, mmu, page_table);
+    allocateVariable(pid, "<GLOBALS>", Char, data_size, mmu, page_table);
+    allocateVariable(pid, "<STACK>", Char, 65536, mmu, page_table);
+    //   - return pid (printed by the caller)
+    return pid;
+}
+
+int allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table)
+{
+    // Hold the process for the whole allocation, other processes are allocated concurrently
+    Process *process = mmu->acquireProcess(pid);
+    if(process == NULL)
+    {
+        printf("error: process not found\n");
+        return -1;
+    }
+
+    // Initialize Data
+    int size = getDataTypeSize(type);
+    uint32_t virtual_addr = -1;
+
+    // Single small elements take a slot in a slab of their size, anything else is placed in the process' free space
+    bool from_slab = mmu->isSlabEnabled() && num_elements == 1 && SlabAllocator::getSizeClass(size) != -1;
+    if(from_slab)
+    {
+        virtual_addr = mmu->allocateFromSlab(pid, size, page_table->getPageSize());
+    }
+    else
+    {
+        virtual_addr = mmu->getFreeSpaceAnywhere(pid, size, page_table->getPageSize(), num_elements);
+    }
+    //! if -1 returned, there is no free memory anywhere
+    if(virtual_addr == -1)
+    {
+        mmu->releaseProcess(process);
+        printf("error: allocation exceeds system memory.\n");
+        return -1;
+    }
+
+    // Load page if memory area falls outside of loaded pages.
+    int page = virtual_addr >> page_table->getOffsetSize();
+    int end_page = virtual_addr + (size * num_elements) >> page_table->getOffsetSize();
+    std::vector<int> new_pages;
+    for(int i = page; i <= end_page; i++)
+    {
+        if(!page_table->entryExists(pid, i))
+        {
+            // If physical memory runs out, undo the pages mapped for this variable
+            if(page_table->addEntry(pid, i) == -1)
+            {
+                for(int j = 0; j < new_pages.size(); j++)
+                {
+                    page_table->removeEntry(pid, new_pages[j]);
+                }
+                if(from_slab)
+                {
+                    mmu->freeSlabSlot(pid, virtual_addr);
+                }
+                mmu->releaseProcess(process);
+                printf("error: allocation exceeds system memory.\n");
+                return -1;
+            }
+            new_pages.push_back(i);
+        }
+    }
+
+    // Insert Variable into MMU and update Free Space
+    mmu->addVariableToProcess(pid, var_name, type, size * num_elements, virtual_addr);
+    if(!from_slab)
+    {
+        mmu->updateFreeSpace(pid, virtual_addr, size * num_elements);
+    }
+    mmu->releaseProcess(process);
+
+    // Print Virtual Memory Address
+    return virtual_addr;
+}
+
+void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory)
+{
+    //   * note: this function only handles a single element (i.e. you'll need to call this within a loop when setting multiple elements of an array)
+
+    // Get variable information from process
+    Process *process = mmu->acquireProcess(pid);
+    if(process == NULL)
+    {
+        return;
+    }
+    Variable* variable = mmu->getVariableByProcessAndName(process, var_name);
+    if(variable != NULL)
+    {
+        setVariableElement(pid, variable, offset, value, page_table, memory);
+    }
+    mmu->releaseProcess(process);
+}
+
+void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table)
+{
+    Process *process = mmu->acquireProcess(pid);
+    if(process == NULL)
+    {
+        return;
+    }
+
+    // Freeing an attached shared memory segment detaches it
+    if(page_table->isAttached(pid, var_name))
+    {
+        detachSegment(pid, var_name, mmu, page_table);
+        mmu->releaseProcess(process);
+        return;
+    }
+
+    // Get vector of pages exclusively containing var_name
+    std::vector<int> exclusive_pages = mmu->getExclusivePages(pid, var_name, page_table->getPageSize());
+
+    // Remove entry from MMU
+    mmu->removeVariable(pid, var_name);
+
+    // Loop through the vector of exclusive pages and remove them from the page table
+    for(int i = 0; i < exclusive_pages.size(); i++) {
+        page_table->removeEntry(pid, exclusive_pages[i]);
+    }
+    mmu->releaseProcess(process);
+}
+
+void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table)
+{
+    Process *process = mmu->acquireProcess(pid);
+    if(process == NULL)
+    {
+        return;
+    }
+
+    // Remove all pages for the process from the page table
+    std::vector<int> process_pages = page_table->getAllPagesForPID(pid);
+    for(int i = 0; i < process_pages.size(); i++)
+    {
+        page_table->removeEntry(pid, process_pages[i]);
+    }
+    page_table->detachAllSegments(pid);
+
+    // Remove Process from the MMU, it is freed once no thread holds it
+    mmu->removeProcess(pid);
+    mmu->releaseProcess(process);
+}
+
+
+
+// ---------------------------------------------------------------------------------------------------------------- //
+// ------------------------------------------------CUSTOM FUNCTIONS------------------------------------------------ //
+// ---------------------------------------------------------------------------------------------------------------- //
+
+/** Forks a process: the child gets a copy of the parent's variables and shares its frames until one of them writes
+ * @param pid PID of the process to fork.
+ * @param mmu The MMU.
+ * @param page_table The page table.
+ * @return PID of the child. -1 if the parent does not exist or its swapped out pages could not be copied.
+ */
+uint32_t forkProcess(uint32_t pid, Mmu *mmu, PageTable *page_table)
+{
+    Process *parent = mmu->acquireProcess(pid);
+    if(parent == NULL)
+    {
+        return -1;
+    }
+
+    uint32_t child_pid = mmu->forkProcess(pid);
+    if(!page_table->forkEntries(pid, child_pid))
+    {
+        terminateProcess(child_pid, mmu, page_table);
+        child_pid = -1;
+    }
+    mmu->releaseProcess(parent);
+    return child_pid;
+}
+
+/** Maps a shared memory segment into a process as a char variable named after the segment
+ * @param pid PID of the process.
+ * @param name Name of the segment.
+ * @param mmu The MMU.
+ * @param page_table The page table.
+ * @return Virtual address the segment is mapped at. -1 if it could not be mapped (the error is printed).
+ */
+int attachSegment(uint32_t pid, std::string name, Mmu *mmu, PageTable *page_table)
+{
+    Process *process = mmu->acquireProcess(pid);
+    if(process == NULL)
+    {
+        printf("error: process not found\n");
+        return -1;
+    }
+
+    uint32_t size = page_table->getSegmentSize(name);
+    int page_size = page_table->getPageSize();
+    if(size == 0)
+    {
+        mmu->releaseProcess(process);
+        printf("error: segment not found\n");
+        return -1;
+    }
+    if(mmu->getVariableByProcessAndName(process, name) != NULL)
+    {
+        mmu->releaseProcess(process);
+        printf("error: variable already exists\n");
+        return -1;
+    }
+
+    // Page sized elements always start on a page boundary, so the segment gets whole pages of its own
+    uint32_t virtual_addr = mmu->getFreeSpaceAnywhere(pid, page_size, page_size, size / page_size);
+    if(virtual_addr == -1 || !page_table->attachSegment(pid, name, virtual_addr))
+    {
+        mmu->releaseProcess(process);
+        printf("error: allocation exceeds system memory.\n");
+        return -1;
+    }
+    mmu->addVariableToProcess(pid, name, Char, size, virtual_addr);
+    mmu->updateFreeSpace(pid, virtual_addr, size);
+    mmu->releaseProcess(process);
+    return virtual_addr;
+}
+
+/** Unmaps a shared memory segment from a process and removes its variable
+ * @param pid PID of the process.
+ * @param name Name of the segment.
+ * @param mmu The MMU.
+ * @param page_table The page table.
+ * @return True if the segment was detached. False if the process is not attached to it.
+ */
+bool detachSegment(uint32_t pid, std::string name, Mmu *mmu, PageTable *page_table)
+{
+    Process *process = mmu->acquireProcess(pid);
+    if(process == NULL)
+    {
+        return false;
+    }
+
+    Variable *variable = mmu->getVariableByProcessAndName(process, name);
+    bool detached = variable != NULL && page_table->detachSegment(pid, name, variable->virtual_address);
+    if(detached)
+    {
+        mmu->removeVariable(pid, name);
+    }
+    mmu->releaseProcess(process);
+    return detached;
+}
+
+/** Sets one element of an already resolved variable.
+ *  @param pid PID of the process the variable belongs to.
+ *  @param variable The variable to set.
+ *  @param offset Index of the element to set.
+ *  @param value Pointer to the new value, the size of one element of the variable's type.
+ *  @param page_table Pointer to the page table used to translate the element's address.
+ *  @param memory Pointer to physical memory.
+ */
+void setVariableElement(uint32_t pid, Variable *variable, uint32_t offset, void *value, PageTable *page_table, void *memory) {
+    int type_size = getDataTypeSize(variable->type);
+
+    // Frames cannot be evicted while the data is copied
+    std::unique_lock<std::recursive_mutex> pager = page_table->lockPager();
+
+    // Get physical address from page table, marking the page dirty so it is written back if evicted
+    int64_t physical_address = page_table->getPhysicalAddress(pid, variable->virtual_address + (offset * type_size), true);
+    if (physical_address == -1)
+    {
+        return;
+    }
+
+    // Copy value into memory with an offset of the physical address
+    memcpy(((char*)memory + physical_address), value, type_size);
+}
+
+/** Sets a run of consecutive elements of an already resolved variable. Each page touched is translated once and
+ *  the part of the run that falls in it is copied with a single memcpy.
+ *  @param pid PID of the process the variable belongs to.
+ *  @param variable The variable to set.
+ *  @param offset Index of the first element to set.
+ *  @param values Pointer to the new values, count elements of the variable's type laid out back to back.
+ *  @param count Number of elements to set.
+ *  @param page_table Pointer to the page table used to translate the elements' addresses.
+ *  @param memory Pointer to physical memory.
+ *  @return True if every element was set. False if a page could not be translated (the elements before it are set).
+ */
+bool setVariableElements(uint32_t pid, Variable *variable, uint32_t offset, const void *values, uint32_t count, PageTable *page_table, void *memory) {
+    uint32_t page_size = page_table->getPageSize();
+    uint32_t virtual_address = variable->virtual_address + (offset * getDataTypeSize(variable->type));
+    uint32_t remaining = count * getDataTypeSize(variable->type);
+    const char *source = (const char*)values;
+
+    // Frames cannot be evicted while the data is copied
+    std::unique_lock<std::recursive_mutex> pager = page_table->lockPager();
+
+    while (remaining > 0)
+    {
+        // Copy up to the end of the current page
+        uint32_t run = std::min(remaining, page_size - (virtual_address & (page_size - 1)));
+        int64_t physical_address = page_table->getPhysicalAddress(pid, virtual_address, true);
+        if (physical_address == -1)
+        {
+            return false;
+        }
+        memcpy((char*)memory + physical_address, source, run);
+
+        virtual_address += run;
+        source += run;
+        remaining -= run;
+    }
+    return true;
+}
+
+/** Reads a run of consecutive elements of a variable into a caller buffer. Each page touched is translated once and
+ *  the part of the run that falls in it is copied with a single memcpy.
+ *  @param pid PID of the process the variable belongs to.
+ *  @param variable The variable to read.
+ *  @param offset Index of the first element to read.
+ *  @param buffer Set to count elements of the variable's type laid out back to back.
+ *  @param count Number of elements to read.
+ *  @param page_table Pointer to the page table used to translate the elements' addresses.
+ *  @param memory Pointer to physical memory.
+ *  @return True if every element was read. False if a page could not be translated.
+ */
+bool readVariableElements(uint32_t pid, Variable *variable, uint32_t offset, void *buffer, uint32_t count, PageTable *page_table, void *memory) {
+    uint32_t page_size = page_table->getPageSize();
+    uint32_t virtual_address = variable->virtual_address + (offset * getDataTypeSize(variable->type));
+    uint32_t remaining = count * getDataTypeSize(variable->type);
+    char *destination = (char*)buffer;
+
+    // Frames cannot be evicted while the data is copied
+    std::unique_lock<std::recursive_mutex> pager = page_table->lockPager();
+
+    while (remaining > 0)
+    {
+        // Copy up to the end of the current page
+        uint32_t run = std::min(remaining, page_size - (virtual_address & (page_size - 1)));
+        int64_t physical_address = page_table->getPhysicalAddress(pid, virtual_address);
+        if (physical_address == -1)
+        {
+            return false;
+        }
+        memcpy(destination, (char*)memory + physical_address, run);
+
+        virtual_address += run;
+        destination += run;
+        remaining -= run;
+    }
+    return true;
+}
+
+/** Writes the whole contents of a variable to a file, streaming it through a fixed size buffer.
+ *  @param pid PID of the process the variable belongs to.
+ *  @param variable The variable to dump.
+ *  @param path Path of the file to create.
+ *  @param text True to write one formatted value per line, false to write the raw bytes.
+ *  @param page_table Pointer to the page table used to translate the variable's addresses.
+ *  @param memory Pointer to physical memory.
+ *  @return True if the whole variable was written. False otherwise.
+ */
+bool dumpVariable(uint32_t pid, Variable *variable, const std::string& path, bool text, PageTable *page_table, void *memory) {
+    FILE *file = fopen(path.c_str(), text ? "w" : "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    // A variable without a type has no elements, so its file is left empty
+    int type_size = getDataTypeSize(variable->type);
+    if (type_size == 0)
+    {
+        return fclose(file) == 0;
+    }
+    uint32_t num_elements = variable->size / type_size;
+    uint32_t chunk_elements = DUMP_BUFFER_SIZE / type_size;
+    std::vector<char> buffer((size_t)chunk_elements * type_size);
+
+    bool ok = true;
+    for (uint32_t first = 0; first < num_elements && ok; first += chunk_elements)
+    {
+        uint32_t count = std::min(chunk_elements, num_elements - first);
+        ok = readVariableElements(pid, variable, first, buffer.data(), count, page_table, memory);
+        if (ok && text)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                printElement(file, variable->type, &buffer[(size_t)i * type_size]);
+                fputc('\n', file);
+            }
+        }
+        else if (ok)
+        {
+            ok = fwrite(buffer.data(), type_size, count, file) == count;
+        }
+    }
+
+    if (fclose(file) != 0)
+    {
+        ok = false;
+    }
+    return ok;
+}
+
+/** Formats one element the way print shows it.
+ *  @param file The file to write to.
+ *  @param type The element's type.
+ *  @param value Pointer to the element.
+ */
+void printElement(FILE *file, DataType type, const void *value) {
+    switch(type) {
+        case DataType::Char:
+            fprintf(file, "%c", *(const char*)value);
+            break;
+        case DataType::Short:
+            fprintf(file, "%d", *(const short*)value);
+            break;
+        case DataType::Long:
+            fprintf(file, "%ld", *(const long*)value);
+            break;
+        case DataType::Int:
+            fprintf(file, "%d", *(const int*)value);
+            break;
+        case DataType::Float:
+            fprintf(file, "%f", *(const float*)value);
+            break;
+        case DataType::Double:
+            fprintf(file, "%lf", *(const double*)value);
+            break;
+        default:
+            break;
+    }
+}
+
+/** Converts a DataType to an integer equal to its corresponding size.
+ *  @param type The given DataType to get the size of.
+ *  @return Returns the corresponding size for the given DataType. Will return 0 if given FreeSpace.
+ */
+int getDataTypeSize(DataType type) {
+    int size = 0; // in bytes
+    switch(type)
+    {
+        case Char:
+            size = 1;
+            break;
+        case Short:
+            size = 2;
+            break;
+        case Int:
+        case Float:
+            size = 4;
+            break;
+        case Long:
+        case Double:
+            size = 8;
+            break;
+    }
+    return size;
+}
+
+/** Converts a string to one of the DataType enumerators defined in mmu.cpp based on its string equivalent.
+ *  @param input The user input string that is meant to be a DataType represented with text.
+ *  @return Returns the associated DataType enum or FreeSpace if no DataType can be associated.
+ */
+DataType stringToDataType(std::string input) {
+    if(input == "char") {
+        return DataType::Char;
+    } else if(input == "short") {
+        return DataType::Short;
+    } else if(input == "int") {
+        return DataType::Int;
+    } else if(input == "float") {
+        return DataType::Float;
+    } else if(input == "long") {
+        return DataType::Long;
+    } else if(input == "double") {
+        return DataType::Double;
+    } else {
+        //If freespace is returned, that means the string was unrecognized
+        return DataType::FreeSpace; 
+    }
+}
+
+/** Compacts a process: slides its variables down to the lowest addresses they fit at (free list heap only, slab
+ *  pages stay in place), unmaps the pages no variable touches any more, and moves its pages into the lowest free frames
+ * @param pid PID of the process to compact.
+ * @param mmu The MMU.
+ * @param page_table The page table.
+ * @param memory Base of physical memory.
+ * @param result Set to what the compaction did.
+ * @return True if the process was compacted. False if it does not exist, or a page could not be mapped or a variable
+ *  could not be copied (the variables after it stay where they are).
+ */
+bool compactProcess(uint32_t pid, Mmu *mmu, PageTable *page_table, void *memory, CompactionResult *result) {
+    memset(result, 0, sizeof(CompactionResult));
+    Process *process = mmu->acquireProcess(pid);
+    if(process == NULL) {
+        return false;
+    }
+    int page_size = page_table->getPageSize();
+    int offset_size = page_table->getOffsetSize();
+    bool mapped = true;
+
+    // Buddy blocks must stay at their aligned addresses, the buddy heap only compacts frames
+    if(mmu->getHeapBackend() == FreeListHeap) {
+        std::vector<Variable*> variables;
+        std::multimap<uint32_t, Variable*>::iterator it;
+        for(it = process->variables.begin(); it != process->variables.end(); it++) {
+            variables.push_back(it->second);
+        }
+
+        std::vector<char> buffer;
+        uint64_t cursor = 0;
+        for(int i = 0; i < variables.size() && mapped; i++) {
+            Variable *variable = variables[i];
+            // Shared memory segments stay mapped where they are
+            if(page_table->isAttached(pid, variable->name)) {
+                cursor = (uint64_t)variable->virtual_address + variable->size;
+                continue;
+            }
+            if(process->slabs.contains(variable->virtual_address)) {
+                uint32_t slab_end = variable->virtual_address - variable->virtual_address % page_size + page_size;
+                cursor = std::max(cursor, (uint64_t)slab_end);
+                continue;
+            }
+
+            // Place the variable as the allocator would in a free extent starting at the cursor
+            int size = getDataTypeSize(variable->type);
+            uint32_t placement;
+            FreeSpaceIndex::fitInExtent(cursor, -1, size, page_size, variable->size / size, &placement);
+            if(placement >= variable->virtual_address) {
+                cursor = (uint64_t)variable->virtual_address + variable->size;
+                continue;
+            }
+
+            // Map the destination before anything moves, so running out of frames leaves the variable where it was
+            for(int page = placement >> offset_size; page <= (placement + variable->size) >> offset_size; page++) {
+                if(!page_table->entryExists(pid, page) && page_table->addEntry(pid, page) == -1) {
+                    mapped = false;
+                    break;
+                }
+            }
+            if(!mapped) {
+                break;
+            }
+
+            // A copy that cannot be made (no frame for a page fault or a copy on write) leaves the variable where it
+            // was, writing its data back over whatever part of the copy landed on its old pages
+            buffer.resize(variable->size);
+            if(!readVariableElements(pid, variable, 0, buffer.data(), variable->size / size, page_table, memory)) {
+                mapped = false;
+                break;
+            }
+            uint32_t old_address = variable->virtual_address;
+            mmu->moveVariable(pid, variable, placement);
+            if(!setVariableElements(pid, variable, 0, buffer.data(), variable->size / size, page_table, memory)) {
+                mmu->moveVariable(pid, variable, old_address);
+                setVariableElements(pid, variable, 0, buffer.data(), variable->size / size, page_table, memory);
+                mapped = false;
+                break;
+            }
+            result->variables_moved++;
+            result->bytes_moved += variable->size;
+            cursor = (uint64_t)placement + variable->size;
+        }
+        mmu->rebuildFreeSpace(pid);
+    }
+
+    // Unmap the pages no variable touches any more
+    std::vector<bool> in_use;
+    std::multimap<uint32_t, Variable*>::iterator it;
+    for(it = process->variables.begin(); it != process->variables.end(); it++) {
+        int end_page = (it->second->virtual_address + it->second->size) >> offset_size;
+        if(end_page >= in_use.size()) {
+            in_use.resize(end_page + 1, false);
+        }
+        for(int page = it->second->virtual_address >> offset_size; page <= end_page; page++) {
+            in_use[page] = true;
+        }
+    }
+    std::vector<int> pages = page_table->getAllPagesForPID(pid);
+    for(int i = 0; i < pages.size(); i++) {
+        if(pages[i] >= in_use.size() || !in_use[pages[i]]) {
+            page_table->removeEntry(pid, pages[i]);
+            result->pages_reclaimed++;
+        }
+    }
+
+    result->frames_moved = page_table->compactFrames(pid, memory);
+    mmu->releaseProcess(process);
+    return mapped;
+}
@@ -0,0 +1,303 @@
+#include "slab.h"
+
+SlabAllocator::SlabAllocator()
+{
+    _page_size = 0;
+    _used_bytes = 0;
+}
+
+SlabAllocator::SlabAllocator(const SlabAllocator& other)
+{
+    _page_size = 0;
+    _used_bytes = 0;
+    *this = other;
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    std::unordered_map<uint32_t, Slab*>::iterator it;
+    for (it = _slabs.begin(); it != _slabs.end(); it++)
+    {
+        delete it->second;
+    }
+}
+
+/** Replaces the slabs with copies of another allocator's slabs, keeping the order of the partial lists
+ * @param other Allocator to copy.
+ * @return This allocator.
+ */
+SlabAllocator& SlabAllocator::operator=(const SlabAllocator& other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    std::unordered_map<uint32_t, Slab*>::iterator it;
+    for (it = _slabs.begin(); it != _slabs.end(); it++)
+    {
+        delete it->second;
+    }
+    _slabs.clear();
+    for (int i = 0; i < SLAB_CLASSES; i++)
+    {
+        _partial[i].clear();
+    }
+
+    _page_size = other._page_size;
+    _used_bytes = other._used_bytes;
+    std::unordered_map<uint32_t, Slab*>::const_iterator other_it;
+    for (other_it = other._slabs.begin(); other_it != other._slabs.end(); other_it++)
+    {
+        _slabs[other_it->first] = new Slab(*other_it->second);
+    }
+    for (int i = 0; i < SLAB_CLASSES; i++)
+    {
+        for (int j = 0; j < other._partial[i].size(); j++)
+        {
+            _partial[i].push_back(_slabs[other._partial[i][j]->address]);
+        }
+    }
+    return *this;
+}
+
+/** Allocates a slot from a slab of the element's size class
+ * @param size Size of the element in bytes.
+ * @return Virtual address of the slot. -1 if every slab of the class is full (or there are none), see addSlab.
+ */
+uint32_t SlabAllocator::allocate(int size)
+{
+    int size_class = getSizeClass(size);
+    if (size_class == -1 || _partial[size_class].empty())
+    {
+        return -1;
+    }
+
+    Slab *slab = _partial[size_class].back();
+    uint32_t word = slab->hint;
+    while (slab->bitmap[word] == ~0ULL)
+    {
+        word++;
+    }
+    int bit = __builtin_ctzll(~slab->bitmap[word]);
+    slab->bitmap[word] |= 1ULL << bit;
+    slab->hint = word;
+    slab->used++;
+    _used_bytes += size;
+    if (slab->used == slab->capacity)
+    {
+        removePartial(slab);
+    }
+    return slab->address + ((word * 64 + bit) << size_class);
+}
+
+/** Adds an empty slab for a size class
+ * @param size Size of the elements the slab holds in bytes.
+ * @param address Start of a page reserved from the heap for the slab, aligned to the page size.
+ * @param page_size Size of one page.
+ */
+void SlabAllocator::addSlab(int size, uint32_t address, uint32_t page_size)
+{
+    int size_class = getSizeClass(size);
+    _page_size = page_size;
+
+    Slab *slab = new Slab();
+    slab->address = address;
+    slab->size_class = size_class;
+    slab->capacity = page_size >> size_class;
+    slab->used = 0;
+    slab->hint = 0;
+    slab->bitmap.assign((slab->capacity + 63) / 64, 0);
+    // Bits past the last slot are marked used so the search never returns them
+    if (slab->capacity % 64 != 0)
+    {
+        slab->bitmap.back() = ~0ULL << (slab->capacity % 64);
+    }
+    slab->partial_index = _partial[size_class].size();
+    _partial[size_class].push_back(slab);
+    _slabs[address] = slab;
+}
+
+/** Frees a slot
+ * @param address Virtual address of the slot.
+ * @return Start address of the slab if freeing the slot left it empty, the page is then no longer part of a slab
+ *  and should be returned to the heap. -1 otherwise.
+ */
+uint32_t SlabAllocator::release(uint32_t address)
+{
+    std::unordered_map<uint32_t, Slab*>::iterator it = _slabs.find(address - address % _page_size);
+    if (it == _slabs.end())
+    {
+        return -1;
+    }
+
+    Slab *slab = it->second;
+    uint32_t slot = (address - slab->address) >> slab->size_class;
+    slab->bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+    slab->hint = std::min(slab->hint, slot / 64);
+    slab->used--;
+    _used_bytes -= 1 << slab->size_class;
+
+    if (slab->used == 0)
+    {
+        uint32_t slab_address = slab->address;
+        if (slab->partial_index != -1)
+        {
+            removePartial(slab);
+        }
+        _slabs.erase(it);
+        delete slab;
+        return slab_address;
+    }
+    // A full slab takes allocations again
+    if (slab->partial_index == -1)
+    {
+        slab->partial_index = _partial[slab->size_class].size();
+        _partial[slab->size_class].push_back(slab);
+    }
+    return -1;
+}
+
+/** Checks if an address lies in a slab
+ * @param address Virtual address to check.
+ * @return True if the address is in one of the slabs. False otherwise.
+ */
+bool SlabAllocator::contains(uint32_t address)
+{
+    return _page_size != 0 && _slabs.count(address - address % _page_size) != 0;
+}
+
+/** Gets the number of bytes in slots that are in use
+ * @return Bytes in use.
+ */
+uint64_t SlabAllocator::getUsedBytes()
+{
+    return _used_bytes;
+}
+
+/** Gets the number of bytes in pages held by slabs
+ * @return Bytes held by slabs.
+ */
+uint64_t SlabAllocator::getSlabBytes()
+{
+    return (uint64_t)_slabs.size() * _page_size;
+}
+
+/** Gets the number of slabs
+ * @return Number of slabs.
+ */
+size_t SlabAllocator::getNumSlabs()
+{
+    return _slabs.size();
+}
+
+/** Gets the size of the pages slabs are carved from
+ * @return Page size in bytes, 0 before the first slab is added.
+ */
+uint32_t SlabAllocator::getPageSize()
+{
+    return _page_size;
+}
+
+/** Writes the slabs to a snapshot, each with its place in its class' partial list
+ * @param writer Snapshot being written.
+ */
+void SlabAllocator::save(SnapshotWriter& writer)
+{
+    writer.put<uint32_t>(_page_size);
+    writer.put<uint64_t>(_used_bytes);
+    writer.put<uint32_t>(_slabs.size());
+    std::unordered_map<uint32_t, Slab*>::iterator it;
+    for (it = _slabs.begin(); it != _slabs.end(); it++)
+    {
+        Slab *slab = it->second;
+        writer.put<uint32_t>(slab->address);
+        writer.put<int32_t>(slab->size_class);
+        writer.put<uint32_t>(slab->used);
+        writer.put<uint32_t>(slab->hint);
+        writer.put<int32_t>(slab->partial_index);
+        writer.write(slab->bitmap.data(), slab->bitmap.size() * sizeof(uint64_t));
+    }
+}
+
+/** Reads the slabs written by save into an allocator with no slabs, rebuilding the partial lists in the same order
+ * @param reader Snapshot being read.
+ * @return True if the slabs were read. False if the snapshot is truncated or a slab is invalid.
+ */
+bool SlabAllocator::load(SnapshotReader& reader)
+{
+    _page_size = reader.get<uint32_t>();
+    _used_bytes = reader.get<uint64_t>();
+    uint32_t count = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < count && reader.ok(); i++)
+    {
+        Slab *slab = new Slab();
+        slab->address = reader.get<uint32_t>();
+        slab->size_class = reader.get<int32_t>();
+        slab->used = reader.get<uint32_t>();
+        slab->hint = reader.get<uint32_t>();
+        slab->partial_index = reader.get<int32_t>();
+        if (_page_size == 0 || slab->size_class < 0 || slab->size_class >= SLAB_CLASSES ||
+            slab->partial_index < -1 || slab->partial_index >= (int)count || _slabs.count(slab->address) != 0)
+        {
+            reader.fail();
+            delete slab;
+            break;
+        }
+        slab->capacity = _page_size >> slab->size_class;
+        slab->bitmap.resize((slab->capacity + 63) / 64);
+        if (slab->used == 0 || slab->used > slab->capacity || slab->hint >= slab->bitmap.size())
+        {
+            reader.fail();
+            delete slab;
+            break;
+        }
+        reader.read(slab->bitmap.data(), slab->bitmap.size() * sizeof(uint64_t));
+        _slabs[slab->address] = slab;
+
+        // Slabs come in any order, each goes straight to its saved place in its partial list
+        if (slab->partial_index != -1)
+        {
+            std::vector<Slab*>& partial = _partial[slab->size_class];
+            if (partial.size() <= slab->partial_index)
+            {
+                partial.resize(slab->partial_index + 1, NULL);
+            }
+            partial[slab->partial_index] = slab;
+        }
+    }
+
+    for (int i = 0; i < SLAB_CLASSES; i++)
+    {
+        if (std::count(_partial[i].begin(), _partial[i].end(), (Slab*)NULL) != 0)
+        {
+            reader.fail();
+        }
+    }
+    return reader.ok();
+}
+
+/** Gets the size class of an element
+ * @param size Size of the element in bytes.
+ * @return Size class, log2 of the size. -1 if the size has no slabs.
+ */
+int SlabAllocator::getSizeClass(int size)
+{
+    if (size <= 0 || size > SLAB_MAX_SIZE || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+    return __builtin_ctz(size);
+}
+
+/** Removes a slab from its class' partial list by moving the last slab of the list into its place
+ * @param slab Slab to remove.
+ */
+void SlabAllocator::removePartial(Slab *slab)
+{
+    std::vector<Slab*>& partial = _partial[slab->size_class];
+    partial[slab->partial_index] = partial.back();
+    partial[slab->partial_index]->partial_index = slab->partial_index;
+    partial.pop_back();
+    slab->partial_index = -1;
+}
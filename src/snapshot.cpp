@@ -0,0 +1,279 @@
+#include "snapshot.h"
+#include "mmu.h"
+#include "pagetable.h"
+#include "physicalmemory.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A snapshot file is laid out as:
+//   header       magic, version, page size, memory size, number of frames, offset of the frame region
+//   processes    written by Mmu::save
+//   page table   written by PageTable::save
+//   frames       the whole of physical memory at a SNAPSHOT_ALIGNMENT boundary, with only the frames in use written;
+//                the rest are holes, so the file takes no more disk space than the frames in use
+
+static bool writeFully(int fd, const char *data, size_t size, uint64_t offset);
+static bool readFully(int fd, char *data, size_t size, uint64_t offset);
+
+SnapshotWriter::SnapshotWriter(FILE *file)
+{
+    _file = file;
+    _ok = true;
+}
+
+/** Writes raw bytes
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ */
+void SnapshotWriter::write(const void *data, size_t size)
+{
+    if (_ok && size != 0 && fwrite(data, 1, size, _file) != size)
+    {
+        _ok = false;
+    }
+}
+
+/** Writes a string as its length followed by its characters
+ * @param value String to write.
+ */
+void SnapshotWriter::putString(const std::string& value)
+{
+    put<uint32_t>(value.size());
+    write(value.data(), value.size());
+}
+
+/** Checks that every write so far succeeded
+ * @return True if nothing failed.
+ */
+bool SnapshotWriter::ok()
+{
+    return _ok;
+}
+
+SnapshotReader::SnapshotReader(FILE *file)
+{
+    _file = file;
+    _ok = true;
+}
+
+/** Reads raw bytes, zeroing them if the read fails
+ * @param data Where to store the bytes.
+ * @param size Number of bytes.
+ */
+void SnapshotReader::read(void *data, size_t size)
+{
+    if (!_ok || fread(data, 1, size, _file) != size)
+    {
+        _ok = false;
+        memset(data, 0, size);
+    }
+}
+
+/** Reads a string written by SnapshotWriter::putString
+ * @return The string, empty if the read fails or its length is over SNAPSHOT_MAX_STRING.
+ */
+std::string SnapshotReader::getString()
+{
+    uint32_t size = get<uint32_t>();
+    if (size > SNAPSHOT_MAX_STRING)
+    {
+        _ok = false;
+    }
+    if (!_ok)
+    {
+        return std::string();
+    }
+    std::string value(size, '\0');
+    read(&value[0], size);
+    return value;
+}
+
+/** Marks the snapshot as invalid, for a value the caller found out of range */
+void SnapshotReader::fail()
+{
+    _ok = false;
+}
+
+/** Checks that every read so far succeeded and no value was rejected
+ * @return True if nothing failed.
+ */
+bool SnapshotReader::ok()
+{
+    return _ok;
+}
+
+/** Writes the whole simulator to a snapshot file. The file is written next to its final path and renamed over it once
+ *  complete, so a failed save never leaves a partial snapshot, and a snapshot that is mapped into memory by load can
+ *  be saved over. No other thread may be running commands.
+ * @param path File to write.
+ * @param mmu Pointer to the mmu.
+ * @param page_table Pointer to the page table.
+ * @param memory Physical memory.
+ * @return True if the snapshot was written. False otherwise.
+ */
+bool saveSnapshot(const std::string& path, Mmu *mmu, PageTable *page_table, PhysicalMemory *memory)
+{
+    std::string temp_path = path + ".tmp";
+    FILE *file = fopen(temp_path.c_str(), "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    SnapshotWriter writer(file);
+    uint32_t page_size = page_table->getPageSize();
+    writer.write(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+    writer.put<uint32_t>(SNAPSHOT_VERSION);
+    writer.put<uint32_t>(page_size);
+    writer.put<uint64_t>(memory->getSize());
+    writer.put<uint32_t>(page_table->getFrameAllocator()->getNumFrames());
+    long offset_position = ftell(file);
+    writer.put<uint64_t>(0);
+    mmu->save(writer);
+    page_table->save(writer);
+
+    // The frame offset is only known once the metadata is written
+    uint64_t frame_offset = ((uint64_t)ftell(file) + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    fseek(file, offset_position, SEEK_SET);
+    writer.put<uint64_t>(frame_offset);
+    bool saved = writer.ok() && fflush(file) == 0;
+
+    // Frames in use are written in runs of consecutive frames, and the file is then extended over the free ones
+    int fd = fileno(file);
+    const char *data = (const char*)memory->getData();
+    std::vector<int> frames = page_table->getFrameAllocator()->getAllocated();
+    for (int i = 0; saved && i < frames.size();)
+    {
+        int run = 1;
+        while (i + run < frames.size() && frames[i + run] == frames[i] + run)
+        {
+            run++;
+        }
+        uint64_t offset = (uint64_t)frames[i] * page_size;
+        saved = writeFully(fd, data + offset, (size_t)run * page_size, frame_offset + offset);
+        i += run;
+    }
+    saved = saved && ftruncate(fd, frame_offset + memory->getSize()) == 0;
+
+    if (fclose(file) != 0 || !saved || rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** Replaces the whole simulator with a snapshot. Anonymous physical memory is mapped straight from the file, so only
+ *  the frames that are touched afterwards are ever read; memory backed by a file has the frames in use copied into it.
+ *  No other thread may be running commands.
+ * @param path File to read.
+ * @param mmu Pointer to the mmu.
+ * @param page_table Pointer to the page table.
+ * @param memory Physical memory.
+ * @return True if the snapshot was loaded. False if it cannot be read or was taken with a different page size,
+ *  memory size or number of frames (the simulator is left as it was), or if it is corrupt (every process is removed).
+ */
+bool loadSnapshot(const std::string& path, Mmu *mmu, PageTable *page_table, PhysicalMemory *memory)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        printf("error: could not open \"%s\"\n", path.c_str());
+        return false;
+    }
+
+    SnapshotReader reader(file);
+    char magic[SNAPSHOT_MAGIC_SIZE];
+    reader.read(magic, SNAPSHOT_MAGIC_SIZE);
+    uint32_t version = reader.get<uint32_t>();
+    uint32_t page_size = reader.get<uint32_t>();
+    uint64_t memory_size = reader.get<uint64_t>();
+    uint32_t num_frames = reader.get<uint32_t>();
+    uint64_t frame_offset = reader.get<uint64_t>();
+    struct stat file_info;
+    if (!reader.ok() || memcmp(magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0 || version != SNAPSHOT_VERSION ||
+        fstat(fileno(file), &file_info) == -1 || (uint64_t)file_info.st_size < frame_offset + memory_size ||
+        frame_offset % SNAPSHOT_ALIGNMENT != 0)
+    {
+        printf("error: \"%s\" is not a complete version %d snapshot\n", path.c_str(), SNAPSHOT_VERSION);
+        fclose(file);
+        return false;
+    }
+    if (page_size != page_table->getPageSize() || memory_size != memory->getSize() ||
+        num_frames != page_table->getFrameAllocator()->getNumFrames())
+    {
+        printf("error: snapshot has a page size of %u, %llu bytes of memory and %u frames\n", page_size,
+               (unsigned long long)memory_size, num_frames);
+        fclose(file);
+        return false;
+    }
+
+    bool loaded = mmu->load(reader) && page_table->load(reader);
+    if (loaded && !memory->mapFile(fileno(file), frame_offset))
+    {
+        char *data = (char*)memory->getData();
+        std::vector<int> frames = page_table->getFrameAllocator()->getAllocated();
+        for (int i = 0; loaded && i < frames.size(); i++)
+        {
+            uint64_t offset = (uint64_t)frames[i] * page_size;
+            loaded = readFully(fileno(file), data + offset, page_size, frame_offset + offset);
+        }
+    }
+    fclose(file);
+
+    if (!loaded)
+    {
+        mmu->clear();
+        page_table->clear();
+        printf("error: \"%s\" is corrupt, every process was removed\n", path.c_str());
+    }
+    return loaded;
+}
+
+/** Writes a buffer to a file at an offset, retrying short writes
+ * @param fd File to write.
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ * @param offset Offset in the file.
+ * @return True if every byte was written.
+ */
+static bool writeFully(int fd, const char *data, size_t size, uint64_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+/** Reads a buffer from a file at an offset, retrying short reads
+ * @param fd File to read.
+ * @param data Where to store the bytes.
+ * @param size Number of bytes.
+ * @param offset Offset in the file.
+ * @return True if every byte was read.
+ */
+static bool readFully(int fd, char *data, size_t size, uint64_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t count = pread(fd, data, size, offset);
+        if (count <= 0)
+        {
+            return false;
+        }
+        data += count;
+        size -= count;
+        offset += count;
+    }
+    return true;
+}
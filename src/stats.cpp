@@ -0,0 +1,243 @@
+#include "stats.h"
+#include <cstring>
+#include <algorithm>
+
+Counter::Counter()
+{
+    _value = 0;
+}
+
+/** Adds to the counter
+ * @param amount Number of events.
+ */
+void Counter::add(uint64_t amount)
+{
+    _value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+/** Gets the counter
+ * @return Number of events so far.
+ */
+uint64_t Counter::get()
+{
+    return _value.load(std::memory_order_relaxed);
+}
+
+/** Resets the counter to zero */
+void Counter::clear()
+{
+    _value = 0;
+}
+
+Histogram::Histogram()
+{
+    clear();
+}
+
+/** Counts one value
+ * @param value The value.
+ */
+void Histogram::record(uint64_t value)
+{
+    int bucket = (value == 0) ? 0 : 64 - __builtin_clzll(value);
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+/** Forgets every value counted */
+void Histogram::clear()
+{
+    for (int i = 0; i < STATS_BUCKETS; i++)
+    {
+        _buckets[i] = 0;
+    }
+    _count = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+/** Gets the number of values counted
+ * @return Number of values.
+ */
+uint64_t Histogram::getCount()
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+/** Gets the mean of the values counted
+ * @return The mean, 0 if nothing was counted.
+ */
+double Histogram::getMean()
+{
+    uint64_t count = getCount();
+    return count == 0 ? 0.0 : (double)_sum.load(std::memory_order_relaxed) / count;
+}
+
+/** Gets the largest value counted
+ * @return The largest value, 0 if nothing was counted.
+ */
+uint64_t Histogram::getMax()
+{
+    return _max.load(std::memory_order_relaxed);
+}
+
+/** Gets an upper bound on a percentile of the values counted
+ * @param percent The percentile, from 0 to 100.
+ * @return The top of the bucket holding the percentile (at most the largest value), 0 if nothing was counted.
+ */
+uint64_t Histogram::getPercentile(double percent)
+{
+    uint64_t count = getCount();
+    uint64_t rank = (uint64_t)(count * percent / 100.0 + 0.5);
+    uint64_t seen = 0;
+    for (int i = 0; i < STATS_BUCKETS && count > 0; i++)
+    {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= std::max(rank, (uint64_t)1))
+        {
+            uint64_t top = (i == 0) ? 0 : (i == 64) ? UINT64_MAX : ((uint64_t)1 << i) - 1;
+            return std::min(top, getMax());
+        }
+    }
+    return getMax();
+}
+
+/** Prints a one line summary of the values counted
+ * @param name Label of the line.
+ * @param unit Unit of the values once scaled.
+ * @param scale Factor the values are multiplied by before they are printed.
+ */
+void Histogram::print(const char *name, const char *unit, double scale)
+{
+    printf("  %-22s %llu, mean %.2f%s, p50 %.2f%s, p99 %.2f%s, max %.2f%s\n", name, (unsigned long long)getCount(),
+           getMean() * scale, unit, getPercentile(50) * scale, unit, getPercentile(99) * scale, unit,
+           getMax() * scale, unit);
+}
+
+/** Writes the summary of the values counted as a JSON object
+ * @param file File to write to.
+ * @param scale Factor the values are multiplied by before they are written.
+ */
+void Histogram::writeJson(FILE *file, double scale)
+{
+    fprintf(file, "{\"count\": %llu, \"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+            (unsigned long long)getCount(), getMean() * scale, getPercentile(50) * scale, getPercentile(99) * scale,
+            getMax() * scale);
+}
+
+CommandStats::CommandStats()
+{
+    _output_interval = 0;
+    _since_output = 0;
+}
+
+/** Counts one command that was run
+ * @param command Index of the command, from getCommand.
+ * @param ns How long it took in nanoseconds.
+ */
+void CommandStats::record(int command, uint64_t ns)
+{
+    _latency[command].record(ns);
+}
+
+/** Prints the number of each command run and how long they took */
+void CommandStats::print()
+{
+    printf(" Command     | Count      | Mean us    | p50 us     | p99 us     | Max us\n");
+    printf("-------------+------------+------------+------------+------------+------------\n");
+    for (int i = 0; i < STATS_COMMANDS; i++)
+    {
+        Histogram& latency = _latency[i];
+        if (latency.getCount() > 0)
+        {
+            printf(" %-11s | %10llu | %10.3f | %10.3f | %10.3f | %10.3f\n", getName(i),
+                   (unsigned long long)latency.getCount(), latency.getMean() / 1e3, latency.getPercentile(50) / 1e3,
+                   latency.getPercentile(99) / 1e3, latency.getMax() / 1e3);
+        }
+    }
+}
+
+/** Writes the latency of each command run, in microseconds, as the members of a JSON object
+ * @param file File to write to.
+ */
+void CommandStats::writeJson(FILE *file)
+{
+    bool first = true;
+    for (int i = 0; i < STATS_COMMANDS; i++)
+    {
+        if (_latency[i].getCount() > 0)
+        {
+            fprintf(file, "%s\n    \"%s\": ", first ? "" : ",", getName(i));
+            _latency[i].writeJson(file, 1e-3);
+            first = false;
+        }
+    }
+}
+
+/** Sets the file all statistics are written to every so many commands
+ * @param path File to write, empty for none.
+ * @param interval Number of commands between writes, at least 1.
+ */
+void CommandStats::setOutput(const std::string& path, uint64_t interval)
+{
+    _output_path = path;
+    _output_interval = interval;
+    _since_output = 0;
+}
+
+/** Gets the file statistics are written to
+ * @return The path, empty if there is none.
+ */
+const std::string& CommandStats::getOutputPath()
+{
+    return _output_path;
+}
+
+/** Counts a command towards the output interval. Only called by the thread reading commands.
+ * @return True if the statistics file should be written now.
+ */
+bool CommandStats::isOutputDue()
+{
+    if (_output_path.empty() || ++_since_output < _output_interval)
+    {
+        return false;
+    }
+    _since_output = 0;
+    return true;
+}
+
+/** Gets the index of a command
+ * @param name Name of the command, as typed at the prompt.
+ * @param length Length of the name.
+ * @return The index, that of "other" if the command is not one that is timed separately.
+ */
+int CommandStats::getCommand(const char *name, size_t length)
+{
+    for (int i = 0; i < STATS_COMMANDS - 1; i++)
+    {
+        const char *command = getName(i);
+        if (strlen(command) == length && memcmp(command, name, length) == 0)
+        {
+            return i;
+        }
+    }
+    return STATS_COMMANDS - 1;
+}
+
+/** Gets the name of a command
+ * @param command Index of the command.
+ * @return The name.
+ */
+const char* CommandStats::getName(int command)
+{
+    static const char *names[STATS_COMMANDS] = {"create", "allocate", "set", "free", "terminate", "fork", "compact",
+                                                "shmcreate", "shmdestroy", "shmattach", "shmdetach", "dump", "print",
+                                                "save", "load", "other"};
+    return names[command];
+}
@@ -0,0 +1,78 @@
+#include "swapfile.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+SwapFile::SwapFile(int page_size)
+{
+    _fd = -1;
+    _page_size = page_size;
+    _num_slots = 0;
+}
+
+SwapFile::~SwapFile()
+{
+    if (_fd != -1)
+    {
+        close(_fd);
+    }
+}
+
+/** Creates (or truncates) the swap file
+ * @param path Path of the file.
+ * @return True if the file was opened. False otherwise.
+ */
+bool SwapFile::open(const std::string& path)
+{
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    return _fd != -1;
+}
+
+/** Reserves a slot for one page, reusing released slots before growing the file
+ * @return The slot number.
+ */
+int SwapFile::allocateSlot()
+{
+    if (!_free_slots.empty())
+    {
+        int slot = _free_slots.back();
+        _free_slots.pop_back();
+        return slot;
+    }
+    return _num_slots++;
+}
+
+/** Releases a slot so it can hold another page
+ * @param slot The slot number.
+ */
+void SwapFile::releaseSlot(int slot)
+{
+    _free_slots.push_back(slot);
+}
+
+/** Writes one page into a slot
+ * @param slot The slot number.
+ * @param data Pointer to page_size bytes to write.
+ * @return True if the whole page was written. False otherwise.
+ */
+bool SwapFile::writePage(int slot, const void *data)
+{
+    return pwrite(_fd, data, _page_size, (off_t)slot * _page_size) == _page_size;
+}
+
+/** Reads one page from a slot
+ * @param slot The slot number.
+ * @param data Pointer to page_size bytes to fill.
+ * @return True if the whole page was read. False otherwise.
+ */
+bool SwapFile::readPage(int slot, void *data)
+{
+    return pread(_fd, data, _page_size, (off_t)slot * _page_size) == _page_size;
+}
+
+/** Gets the number of slots holding pages
+ * @return Number of slots in use.
+ */
+uint32_t SwapFile::getSlotsInUse()
+{
+    return _num_slots - _free_slots.size();
+}
@@ -0,0 +1,209 @@
+#include "tlb.h"
+#include <cstdio>
+
+Tlb::Tlb(uint32_t num_entries, uint32_t ways, TlbReplacement replacement, bool tag_pids)
+{
+    // No ways makes the TLB a single fully associative set
+    if (ways == 0)
+    {
+        ways = num_entries;
+    }
+    _ways = ways;
+    _num_sets = num_entries / ways;
+    _replacement = replacement;
+    _tag_pids = tag_pids;
+    _current_pid = 0;
+    _hits = 0;
+    _misses = 0;
+    _flushes = 0;
+
+    TlbEntry empty = {false, 0, 0, -1, 0};
+    _entries.resize(_num_sets * _ways, empty);
+    _sets = new TlbSet[_num_sets];
+    for (uint32_t i = 0; i < _num_sets; i++)
+    {
+        _sets[i].clock = 0;
+        _sets[i].random_state = 0x9E3779B9 + i;
+    }
+}
+
+Tlb::~Tlb()
+{
+    delete[] _sets;
+}
+
+/** Looks up the frame for a page of a process
+ * @param pid ID of the process doing the translation.
+ * @param page Page number to translate.
+ * @return The cached frame number, or -1 on a miss.
+ */
+int Tlb::lookup(uint32_t pid, uint32_t page)
+{
+    std::unique_lock<std::mutex> context(_switch_lock, std::defer_lock);
+    if (!_tag_pids)
+    {
+        context.lock();
+        switchProcess(pid);
+    }
+
+    TlbSet& state = getSetState(page);
+    std::lock_guard<std::mutex> guard(state.lock);
+    TlbEntry *set = getSet(page);
+    for (uint32_t i = 0; i < _ways; i++)
+    {
+        if (set[i].valid && set[i].page == page && set[i].pid == pid)
+        {
+            set[i].last_used = ++state.clock;
+            _hits++;
+            return set[i].frame;
+        }
+    }
+    _misses++;
+    return -1;
+}
+
+/** Caches a translation, evicting an entry of the set if it is full
+ * @param pid ID of the process the page belongs to.
+ * @param page Page number.
+ * @param frame Frame number the page maps to.
+ */
+void Tlb::insert(uint32_t pid, uint32_t page, int frame)
+{
+    std::unique_lock<std::mutex> context(_switch_lock, std::defer_lock);
+    if (!_tag_pids)
+    {
+        context.lock();
+        switchProcess(pid);
+    }
+
+    TlbSet& state = getSetState(page);
+    std::lock_guard<std::mutex> guard(state.lock);
+    TlbEntry *set = getSet(page);
+    TlbEntry *victim = NULL;
+    for (uint32_t i = 0; i < _ways && victim == NULL; i++)
+    {
+        if (!set[i].valid)
+        {
+            victim = &set[i];
+        }
+    }
+
+    if (victim == NULL)
+    {
+        if (_replacement == TlbRandom)
+        {
+            // xorshift32
+            state.random_state ^= state.random_state << 13;
+            state.random_state ^= state.random_state >> 17;
+            state.random_state ^= state.random_state << 5;
+            victim = &set[state.random_state % _ways];
+        }
+        else
+        {
+            victim = &set[0];
+            for (uint32_t i = 1; i < _ways; i++)
+            {
+                if (set[i].last_used < victim->last_used)
+                {
+                    victim = &set[i];
+                }
+            }
+        }
+    }
+
+    victim->valid = true;
+    victim->pid = pid;
+    victim->page = page;
+    victim->frame = frame;
+    victim->last_used = ++state.clock;
+}
+
+/** Drops the cached translation of a single page
+ * @param pid ID of the process the page belongs to.
+ * @param page Page number.
+ */
+void Tlb::invalidate(uint32_t pid, uint32_t page)
+{
+    std::lock_guard<std::mutex> guard(getSetState(page).lock);
+    TlbEntry *set = getSet(page);
+    for (uint32_t i = 0; i < _ways; i++)
+    {
+        if (set[i].valid && set[i].page == page && set[i].pid == pid)
+        {
+            set[i].valid = false;
+        }
+    }
+}
+
+/** Drops every cached translation
+ */
+void Tlb::flush()
+{
+    for (uint32_t set = 0; set < _num_sets; set++)
+    {
+        std::lock_guard<std::mutex> guard(_sets[set].lock);
+        for (uint32_t i = set * _ways; i < (set + 1) * _ways; i++)
+        {
+            _entries[i].valid = false;
+        }
+    }
+    _flushes++;
+}
+
+void Tlb::print(int page_size)
+{
+    printf("TLB: %u entries, %u-way, %s replacement, %s\n", _num_sets * _ways, _ways,
+           _replacement == TlbLru ? "LRU" : "random", _tag_pids ? "PID tagged" : "flush on switch");
+    printf("  reach:    %llu bytes\n", (unsigned long long)_num_sets * _ways * page_size);
+    printf("  hits:     %llu\n", (unsigned long long)_hits.load());
+    printf("  misses:   %llu\n", (unsigned long long)_misses.load());
+    printf("  flushes:  %llu\n", (unsigned long long)_flushes.load());
+    printf("  hit rate: %.2f%%\n", getHitRate() * 100.0);
+}
+
+uint64_t Tlb::getHits()
+{
+    return _hits;
+}
+
+uint64_t Tlb::getMisses()
+{
+    return _misses;
+}
+
+double Tlb::getHitRate()
+{
+    uint64_t hits = _hits;
+    uint64_t total = hits + _misses;
+    return total == 0 ? 0.0 : (double)hits / (double)total;
+}
+
+/** Gets the first entry of the set a page maps to
+ * @param page Page number.
+ * @return Pointer to the first of the set's entries.
+ */
+TlbEntry* Tlb::getSet(uint32_t page)
+{
+    return &_entries[(page % _num_sets) * _ways];
+}
+
+/** Gets the lock and replacement state of the set a page maps to
+ * @param page Page number.
+ * @return The set's state.
+ */
+TlbSet& Tlb::getSetState(uint32_t page)
+{
+    return _sets[page % _num_sets];
+}
+
+/** Flushes the TLB on a context switch when entries are not tagged with PIDs. The caller holds the switch lock.
+ * @param pid ID of the process now translating.
+ */
+void Tlb::switchProcess(uint32_t pid)
+{
+    if (!_tag_pids && pid != _current_pid)
+    {
+        flush();
+    }
+    _current_pid = pid;
+}
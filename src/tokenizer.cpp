@@ -0,0 +1,170 @@
+#include "tokenizer.h"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+/** Compares the token to a string
+ * @param text Null terminated string to compare against.
+ * @return True if the token has exactly the same characters. False otherwise.
+ */
+bool Token::equals(const char *text) const
+{
+    return strncmp(data, text, length) == 0 && text[length] == '\0';
+}
+
+/** Copies the token into a string
+ * @return The token's characters.
+ */
+std::string Token::str() const
+{
+    return std::string(data, length);
+}
+
+/** Splits a line into tokens without copying it. Tokens are separated by the delimiter, and text between double
+ *  quotes is a single token.
+ * @param text Line to split.
+ * @param d Character delimiter to split text on.
+ * @param result Vector of tokens - result will be stored here.
+ */
+void tokenize(const std::string& text, char d, std::vector<Token>& result)
+{
+    enum states { NONE, IN_WORD, IN_STRING } state = NONE;
+
+    const char *line = text.c_str();
+    size_t length = text.length();
+    Token token = {NULL, 0};
+    result.clear();
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = line[i];
+        switch (state) {
+            case NONE:
+                if (c != d)
+                {
+                    if (c == '\"')
+                    {
+                        state = IN_STRING;
+                        token.data = line + i + 1;
+                    }
+                    else
+                    {
+                        state = IN_WORD;
+                        token.data = line + i;
+                    }
+                }
+                break;
+            case IN_WORD:
+                if (c == d)
+                {
+                    token.length = (line + i) - token.data;
+                    result.push_back(token);
+                    state = NONE;
+                }
+                break;
+            case IN_STRING:
+                if (c == '\"')
+                {
+                    token.length = (line + i) - token.data;
+                    result.push_back(token);
+                    state = NONE;
+                }
+                break;
+        }
+    }
+    if (state != NONE)
+    {
+        token.length = (line + length) - token.data;
+        result.push_back(token);
+    }
+}
+
+/** Parses a whole token as a signed decimal integer
+ * @param token Token to parse.
+ * @param value Set to the parsed number.
+ * @return True if the token is a valid integer that fits in a long. False otherwise.
+ */
+bool parseLong(const Token& token, long *value)
+{
+    const char *c = token.data;
+    const char *end = token.data + token.length;
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+'))
+    {
+        negative = (*c == '-');
+        c++;
+    }
+    if (c == end)
+    {
+        return false;
+    }
+
+    // A negative number may go one past LONG_MAX
+    unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    unsigned long result = 0;
+    for (; c < end; c++)
+    {
+        unsigned digit = (unsigned)(*c - '0');
+        if (digit > 9 || result > (limit - digit) / 10)
+        {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    *value = (negative && result > 0) ? -(long)(result - 1) - 1 : (long)result;
+    return true;
+}
+
+/** Parses a whole token as an unsigned 32 bit decimal integer
+ * @param token Token to parse.
+ * @param value Set to the parsed number.
+ * @return True if the token is a valid, non-negative integer. False otherwise.
+ */
+bool parseUnsigned(const Token& token, uint32_t *value)
+{
+    long result;
+    if (!parseLong(token, &result) || result < 0 || result > 0xFFFFFFFFL)
+    {
+        return false;
+    }
+    *value = (uint32_t)result;
+    return true;
+}
+
+/** Parses a token as a floating point number. Integers that fit in a long are parsed without going through strtod.
+ * @param token Token to parse.
+ * @param value Set to the parsed number.
+ * @return True if the token starts with a valid number. False otherwise.
+ */
+bool parseDouble(const Token& token, double *value)
+{
+    long integer;
+    if (parseLong(token, &integer))
+    {
+        *value = (double)integer;
+        return true;
+    }
+
+    // Tokens are followed by a delimiter, quote or the end of the line, all of which stop strtod
+    char *end;
+    *value = strtod(token.data, &end);
+    return end != token.data && end <= token.data + token.length;
+}
+
+/** Parses a token as a single precision floating point number
+ * @param token Token to parse.
+ * @param value Set to the parsed number.
+ * @return True if the token starts with a valid number. False otherwise.
+ */
+bool parseFloat(const Token& token, float *value)
+{
+    long integer;
+    if (parseLong(token, &integer))
+    {
+        *value = (float)integer;
+        return true;
+    }
+
+    char *end;
+    *value = strtof(token.data, &end);
+    return end != token.data && end <= token.data + token.length;
+}
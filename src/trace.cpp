@@ -0,0 +1,299 @@
+#include "trace.h"
+#include <cstring>
+#include <algorithm>
+
+TraceWriter::TraceWriter()
+{
+    _file = NULL;
+    _ok = true;
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+/** Creates a trace file and writes its header
+ * @param path Path of the file.
+ * @param page_size Page size the commands are run with.
+ * @return True if the file was created. False otherwise.
+ */
+bool TraceWriter::open(const std::string& path, uint32_t page_size)
+{
+    _file = fopen(path.c_str(), "wb");
+    if (_file == NULL)
+    {
+        return false;
+    }
+    _buffer.reserve(TRACE_BUFFER_SIZE);
+    putBytes(TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    putVarint(TRACE_VERSION);
+    putVarint(page_size);
+    return true;
+}
+
+/** Writes out what is buffered and closes the file
+ * @return True if every command was written. False otherwise.
+ */
+bool TraceWriter::close()
+{
+    if (_file == NULL)
+    {
+        return _ok;
+    }
+    flush();
+    _ok = fclose(_file) == 0 && _ok;
+    _file = NULL;
+    return _ok;
+}
+
+/** Gets the id of a string, writing a TraceName record for it the first time it is seen. Must be called before the
+ *  record that uses the id is started.
+ * @param name The string.
+ * @return The string's id.
+ */
+uint32_t TraceWriter::intern(const std::string& name)
+{
+    std::unordered_map<std::string, uint32_t>::iterator it = _names.find(name);
+    if (it != _names.end())
+    {
+        return it->second;
+    }
+    uint32_t id = _names.size();
+    _names[name] = id;
+    putOp(TraceName);
+    putVarint(name.size());
+    putBytes(name.data(), name.size());
+    return id;
+}
+
+/** Starts a record
+ * @param op The command.
+ */
+void TraceWriter::putOp(TraceOp op)
+{
+    if (_buffer.size() >= TRACE_BUFFER_SIZE)
+    {
+        flush();
+    }
+    _buffer.push_back(op);
+}
+
+/** Writes an unsigned integer in 7 bit groups, low group first, with the top bit of each byte set if more follow
+ * @param value The integer.
+ */
+void TraceWriter::putVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        _buffer.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    _buffer.push_back((uint8_t)value);
+}
+
+/** Writes raw bytes
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ */
+void TraceWriter::putBytes(const void *data, size_t size)
+{
+    _buffer.insert(_buffer.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+/** Writes out the buffer */
+void TraceWriter::flush()
+{
+    if (!_buffer.empty() && fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size())
+    {
+        _ok = false;
+    }
+    _buffer.clear();
+}
+
+TraceReader::TraceReader()
+{
+    _file = NULL;
+    _position = 0;
+    _end = 0;
+    _ok = true;
+}
+
+TraceReader::~TraceReader()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+    }
+}
+
+/** Opens a trace file and reads its header
+ * @param path Path of the file.
+ * @param page_size Set to the page size the commands were run with.
+ * @return True if the file is a trace of this version. False otherwise.
+ */
+bool TraceReader::open(const std::string& path, uint32_t *page_size)
+{
+    _file = fopen(path.c_str(), "rb");
+    if (_file == NULL)
+    {
+        return false;
+    }
+    _buffer.resize(TRACE_BUFFER_SIZE);
+
+    const char *magic = getBytes(TRACE_MAGIC_SIZE);
+    bool valid = memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) == 0 && getVarint() == TRACE_VERSION;
+    *page_size = getVarint();
+    return valid && _ok;
+}
+
+/** Reads the opcode of the next command, taking in any strings interned before it
+ * @param op Set to the command.
+ * @return True if a command was read. False at the end of the trace, or if it is corrupt (see ok).
+ */
+bool TraceReader::nextOp(TraceOp *op)
+{
+    while (true)
+    {
+        if (_position == _end && !fill())
+        {
+            return false;
+        }
+        uint8_t value = _buffer[_position++];
+        if (value >= TRACE_OPS)
+        {
+            _ok = false;
+            return false;
+        }
+        if (value != TraceName)
+        {
+            *op = (TraceOp)value;
+            return true;
+        }
+
+        uint64_t size = getVarint();
+        if (size > TRACE_MAX_LENGTH)
+        {
+            _ok = false;
+        }
+        if (!_ok)
+        {
+            return false;
+        }
+        const char *name = getBytes(size);
+        _names.push_back(std::string(name, size));
+    }
+}
+
+/** Reads an integer written by TraceWriter::putVarint
+ * @return The integer, 0 if the trace ends first.
+ */
+uint64_t TraceReader::getVarint()
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t byte = getByte();
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+    _ok = false;
+    return 0;
+}
+
+/** Reads the id of an interned string
+ * @return The string, empty if the id was never defined.
+ */
+const std::string& TraceReader::getName()
+{
+    static const std::string none;
+    uint64_t id = getVarint();
+    if (id >= _names.size())
+    {
+        _ok = false;
+        return none;
+    }
+    return _names[id];
+}
+
+/** Reads raw bytes
+ * @param size Number of bytes, at most TRACE_MAX_LENGTH.
+ * @return The bytes, valid until the next read. Zeros if the trace ends first.
+ */
+const char* TraceReader::getBytes(size_t size)
+{
+    // Bytes that are all in the buffer are used in place
+    if (_end - _position >= size)
+    {
+        const char *data = (const char*)&_buffer[_position];
+        _position += size;
+        return data;
+    }
+
+    _payload.assign(size, 0);
+    size_t copied = 0;
+    while (copied < size && (_position < _end || fill()))
+    {
+        size_t count = std::min(size - copied, _end - _position);
+        memcpy(&_payload[copied], &_buffer[_position], count);
+        _position += count;
+        copied += count;
+    }
+    if (copied < size)
+    {
+        _ok = false;
+    }
+    return _payload.data();
+}
+
+/** Marks the trace as corrupt, for an operand the caller found out of range */
+void TraceReader::fail()
+{
+    _ok = false;
+}
+
+/** Checks that the trace was well formed so far
+ * @return True if nothing was truncated or out of range.
+ */
+bool TraceReader::ok()
+{
+    return _ok;
+}
+
+/** Gets the command name of an opcode, as typed at the prompt
+ * @param op The opcode.
+ * @return The name.
+ */
+const char* TraceReader::getOpName(TraceOp op)
+{
+    static const char *names[TRACE_OPS] = {"name", "create", "allocate", "set", "free", "terminate", "fork", "compact",
+                                           "compact all", "shmcreate", "shmdestroy", "shmattach", "shmdetach", "dump",
+                                           "print", "save", "load"};
+    return op < TRACE_OPS ? names[op] : "unknown";
+}
+
+/** Reads one byte
+ * @return The byte, 0 if the trace ends first.
+ */
+uint8_t TraceReader::getByte()
+{
+    if (_position == _end && !fill())
+    {
+        _ok = false;
+        return 0;
+    }
+    return _buffer[_position++];
+}
+
+/** Reads the next chunk of the file into the buffer
+ * @return True if any bytes were read. False at the end of the file.
+ */
+bool TraceReader::fill()
+{
+    _position = 0;
+    _end = fread(&_buffer[0], 1, _buffer.size(), _file);
+    return _end > 0;
+}